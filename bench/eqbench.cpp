@@ -0,0 +1,105 @@
+// Copyright (c) 2018 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+
+/**
+ * @file eqbench.cpp
+ *
+ * @brief Cost per frame of the equalizer kernels the CPU supports, for 1
+ * to Equalizer::MAX_BANDS bands on mono, stereo and 4 channel streams.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+#include "logging.h"
+#include "dsp/equalizer.h"
+
+PmLogContext logContext;
+
+static const char* const logContextName = "audiooutputd-bench";
+static const unsigned int rate = 48000;
+static const size_t periodFrames = 480;
+static const unsigned int channelCounts[] = { 1, 2, 4 };
+static const size_t bandCounts[] = { 1, 3, 5, Equalizer::MAX_BANDS };
+
+int main(int argc, char **argv)
+{
+    int iterations = (argc > 1) ? atoi(argv[1]) : 20000;
+    if (iterations <= 0)
+    {
+        std::cerr << "usage: " << argv[0] << " [iterations]" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    if (kPmLogErr_None != PmLogGetContext(logContextName, &logContext))
+    {
+        std::cerr << "Failed to setup up log context " << logContextName << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::vector<float> input(periodFrames * Equalizer::MAX_CHANNELS);
+    unsigned int seed = 1;
+    for (float& sample: input)
+    {
+        seed = seed * 1103515245 + 12345;
+        sample = static_cast<int16_t>(seed >> 16);
+    }
+
+    for (unsigned int channels: channelCounts)
+    {
+        for (size_t bandCount: bandCounts)
+        {
+            // Peaking bands spread over the spectrum
+            std::vector<EqBand> bands;
+            for (size_t band = 0; band < bandCount; band++)
+            {
+                bands.push_back({EqBandType::PEAKING, 50.0f * (band + 1) * (band + 1), 3.0f, 1.0f});
+            }
+
+            double scalar = 0.0;
+            for (const EqKernels* kernels: getSupportedEqKernels())
+            {
+                // Filter state carries from period to period as in the mixer
+                std::vector<float> samples(periodFrames * channels);
+                Equalizer equalizer(*kernels);
+
+                equalizer.setBands(bands);
+                equalizer.prepare(rate, channels);
+
+                auto start = std::chrono::steady_clock::now();
+                for (int i = 0; i < iterations; i++)
+                {
+                    std::copy(input.begin(), input.begin() + samples.size(), samples.begin());
+                    equalizer.process(samples.data(), periodFrames);
+                }
+                auto elapsed = std::chrono::steady_clock::now() - start;
+                double nsPerFrame = std::chrono::duration<double, std::nano>(elapsed).count() / iterations / periodFrames;
+
+                if (kernels == getSupportedEqKernels().front())
+                    scalar = nsPerFrame;
+
+                std::cout << channels << " channels, " << bandCount << " bands, " << kernels->name << ": "
+                          << nsPerFrame << " ns/frame, " << scalar / nsPerFrame << "x scalar" << std::endl;
+            }
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,249 @@
+// Copyright (c) 2018 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+
+#include <pbnjson.hpp>
+#include "luna-service2/lunaservice.hpp"
+
+struct LSHandle
+{
+    struct Category
+    {
+        const LSMethod *methods;
+        void *data;
+    };
+
+    std::string name;
+    std::map<std::string, Category> categories;
+    LS::Handle::ReplyHandler replyHandler;
+    LSMessageToken lastToken = 0;
+};
+
+struct LSMessage
+{
+    LSHandle *handle;
+    LSMessageToken token;
+    std::string category;
+    std::string method;
+    std::string payload;
+    std::string sender;
+    int refs;
+};
+
+void LSMessageRef(LSMessage *message)
+{
+    message->refs++;
+}
+
+void LSMessageUnref(LSMessage *message)
+{
+    if (0 == --message->refs)
+    {
+        delete message;
+    }
+}
+
+LSHandle *LSMessageGetConnection(LSMessage *message)
+{
+    return message->handle;
+}
+
+LSMessageToken LSMessageGetToken(LSMessage *message)
+{
+    return message->token;
+}
+
+const char *LSMessageGetCategory(LSMessage *message)
+{
+    return message->category.c_str();
+}
+
+const char *LSMessageGetMethod(LSMessage *message)
+{
+    return message->method.c_str();
+}
+
+const char *LSMessageGetPayload(LSMessage *message)
+{
+    return message->payload.c_str();
+}
+
+const char *LSMessageGetSender(LSMessage *message)
+{
+    return message->sender.c_str();
+}
+
+const char *LSMessageGetSenderServiceName(LSMessage *message)
+{
+    return message->sender.c_str();
+}
+
+const char *LSMessageGetApplicationID(LSMessage *message)
+{
+    return nullptr;
+}
+
+bool LSMessageIsSubscription(LSMessage *message)
+{
+    pbnjson::JDomParser parser;
+
+    if (!parser.parse(message->payload, pbnjson::JSchema::AllSchema()))
+    {
+        return false;
+    }
+
+    pbnjson::JValue request = parser.getDom();
+    return request.isObject() && request["subscribe"].asBool();
+}
+
+namespace LS {
+
+Message::Message(LSMessage *message) : mMessage(message)
+{
+    if (mMessage)
+    {
+        LSMessageRef(mMessage);
+    }
+}
+
+Message::Message(const Message &other) : Message(other.mMessage)
+{
+}
+
+Message &Message::operator=(const Message &other)
+{
+    if (other.mMessage)
+    {
+        LSMessageRef(other.mMessage);
+    }
+    if (mMessage)
+    {
+        LSMessageUnref(mMessage);
+    }
+    mMessage = other.mMessage;
+    return *this;
+}
+
+Message::~Message()
+{
+    if (mMessage)
+    {
+        LSMessageUnref(mMessage);
+    }
+}
+
+void Message::respond(const char *payload)
+{
+    if (!mMessage)
+    {
+        throw Error("respond on an empty message");
+    }
+
+    LSHandle *handle = mMessage->handle;
+    if (handle->replyHandler)
+    {
+        handle->replyHandler(mMessage->token, payload);
+    }
+}
+
+Handle::Handle() : mHandle(new LSHandle)
+{
+}
+
+Handle::Handle(const char *name) : mHandle(new LSHandle)
+{
+    mHandle->name = name;
+}
+
+Handle::~Handle()
+{
+    delete mHandle;
+}
+
+void Handle::registerCategory(const char *category, const LSMethod *methods,
+                              const void *, const void *)
+{
+    if (!mHandle->categories.emplace(category, LSHandle::Category{methods, nullptr}).second)
+    {
+        throw Error(std::string("category already registered: ") + category);
+    }
+}
+
+void Handle::setCategoryData(const char *category, void *data)
+{
+    auto iter = mHandle->categories.find(category);
+    if (iter == mHandle->categories.end())
+    {
+        throw Error(std::string("unknown category: ") + category);
+    }
+    iter->second.data = data;
+}
+
+void Handle::setReplyHandler(ReplyHandler handler)
+{
+    mHandle->replyHandler = std::move(handler);
+}
+
+LSMessageToken Handle::call(const std::string &uri, const std::string &payload, const char *sender)
+{
+    std::string::size_type slash = uri.rfind('/');
+    if (std::string::npos == slash || 0 == slash)
+    {
+        return 0;
+    }
+
+    auto category = mHandle->categories.find(uri.substr(0, slash));
+    if (category == mHandle->categories.end())
+    {
+        return 0;
+    }
+
+    std::string method = uri.substr(slash + 1);
+    for (const LSMethod *entry = category->second.methods; entry->name; entry++)
+    {
+        if (method != entry->name)
+        {
+            continue;
+        }
+
+        LSMessage *message = new LSMessage{mHandle, ++mHandle->lastToken, category->first,
+                                           method, payload, sender, 1};
+        LSMessageToken token = message->token;
+
+        entry->function(mHandle, message, category->second.data);
+        LSMessageUnref(message);
+        return token;
+    }
+
+    return 0;
+}
+
+bool SubscriptionPoint::subscribe(Message &message)
+{
+    mSubscribers.push_back(message);
+    return true;
+}
+
+bool SubscriptionPoint::post(const char *payload)
+{
+    for (auto &subscriber: mSubscribers)
+    {
+        subscriber.respond(payload);
+    }
+    return true;
+}
+
+} // namespace LS
@@ -0,0 +1,102 @@
+// Copyright (c) 2018 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+
+#include <chrono>
+#include <functional>
+#include <random>
+#include <thread>
+#include "umiclient.h"
+
+umiClient* umiClient::getInstance()
+{
+    static umiClient instance;
+    return &instance;
+}
+
+umiClient::umiClient()
+        : mLatencyUs(0)
+        , mFailureRate(0.0)
+        , mCalls(0)
+{
+}
+
+void umiClient::configure(unsigned latencyUs, double failureRate)
+{
+    mLatencyUs = latencyUs;
+    mFailureRate = failureRate;
+}
+
+UMI_ERROR umiClient::call()
+{
+    // HAL calls arrive from several executor workers
+    static thread_local std::minstd_rand random(std::hash<std::thread::id>()(std::this_thread::get_id()));
+    std::uniform_real_distribution<double> distribution(0.0, 1.0);
+
+    mCalls++;
+
+    if (mLatencyUs)
+    {
+        std::this_thread::sleep_for(std::chrono::microseconds(mLatencyUs));
+    }
+
+    return (distribution(random) < mFailureRate) ? UMI_ERROR_FAIL : UMI_ERROR_NONE;
+}
+
+bool umiClient::initialize()
+{
+    return true;
+}
+
+bool umiClient::deinitialize()
+{
+    return true;
+}
+
+UMI_ERROR umiClient::connectInput(UMI_AUDIO_RESOURCE_T resource)
+{
+    return call();
+}
+
+UMI_ERROR umiClient::disconnectInput(UMI_AUDIO_RESOURCE_T resource)
+{
+    return call();
+}
+
+UMI_ERROR umiClient::setMute(UMI_AUDIO_RESOURCE_T resource, bool mute)
+{
+    return call();
+}
+
+UMI_ERROR umiClient::setSoundOutput(UMI_AUDIO_SNDOUT_T soundOut)
+{
+    return call();
+}
+
+UMI_ERROR umiClient::setOutputVolume(UMI_AUDIO_SNDOUT_T soundOut, SpeakerVolume volume)
+{
+    return call();
+}
+
+UMI_ERROR umiClient::setOutputMute(UMI_AUDIO_SNDOUT_T soundOut, bool mute)
+{
+    return call();
+}
+
+SpeakerVolume umiClient::getDefaultVolume()
+{
+    return 50;
+}
@@ -0,0 +1,59 @@
+// Copyright (c) 2018 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+
+/**
+ * @file lunaservice.h
+ *
+ * @brief In-process stand-in for the luna-service2 C API, covering what the
+ * service uses. Benchmarks only, there is no bus behind it.
+ */
+#ifndef FAKE_LUNASERVICE_H
+#define FAKE_LUNASERVICE_H
+
+#include <glib.h>
+
+struct LSHandle;
+struct LSMessage;
+
+typedef unsigned long LSMessageToken;
+
+typedef bool (*LSMethodFunction)(LSHandle *sh, LSMessage *msg, void *category_context);
+
+typedef enum {
+    LUNA_METHOD_FLAGS_NONE = 0
+} LSMethodFlags;
+
+typedef struct LSMethod {
+    const char *name;
+    LSMethodFunction function;
+    LSMethodFlags flags;
+} LSMethod;
+
+void LSMessageRef(LSMessage *message);
+void LSMessageUnref(LSMessage *message);
+
+LSHandle *LSMessageGetConnection(LSMessage *message);
+LSMessageToken LSMessageGetToken(LSMessage *message);
+const char *LSMessageGetCategory(LSMessage *message);
+const char *LSMessageGetMethod(LSMessage *message);
+const char *LSMessageGetPayload(LSMessage *message);
+const char *LSMessageGetSender(LSMessage *message);
+const char *LSMessageGetSenderServiceName(LSMessage *message);
+const char *LSMessageGetApplicationID(LSMessage *message);
+bool LSMessageIsSubscription(LSMessage *message);
+
+#endif
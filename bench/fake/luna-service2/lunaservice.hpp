@@ -0,0 +1,134 @@
+// Copyright (c) 2018 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+
+/**
+ * @file lunaservice.hpp
+ *
+ * @brief In-process stand-in for the luna-service2++ classes used by the
+ * service. Handle::call() dispatches a request straight to the registered
+ * category method and responses are handed to the Handle's reply handler.
+ */
+#ifndef FAKE_LUNASERVICE_HPP
+#define FAKE_LUNASERVICE_HPP
+
+#include <exception>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+#include "lunaservice.h"
+
+#define LS_CATEGORY_METHOD(name) { #name, \
+    &LS::Handle::methodWraper<cl_t, &cl_t::name>, \
+    static_cast<LSMethodFlags>(0) },
+
+namespace LS {
+
+class Error : public std::exception
+{
+public:
+    explicit Error(const std::string &message) : mMessage(message) {}
+
+    const char *what() const noexcept override { return mMessage.c_str(); }
+
+private:
+    std::string mMessage;
+};
+
+class Message
+{
+public:
+    Message() : mMessage(nullptr) {}
+    explicit Message(LSMessage *message);
+    Message(const Message &other);
+    Message &operator=(const Message &other);
+    ~Message();
+
+    LSMessage *get() const { return mMessage; }
+
+    const char *getPayload() const { return LSMessageGetPayload(mMessage); }
+    const char *getCategory() const { return LSMessageGetCategory(mMessage); }
+    const char *getMethod() const { return LSMessageGetMethod(mMessage); }
+    const char *getSender() const { return LSMessageGetSender(mMessage); }
+    const char *getSenderServiceName() const { return LSMessageGetSenderServiceName(mMessage); }
+    bool isSubscription() const { return LSMessageIsSubscription(mMessage); }
+
+    void respond(const char *payload);
+
+private:
+    LSMessage *mMessage;
+};
+
+class Handle
+{
+public:
+    /**
+     * Called for every response and subscription post, with the token
+     * returned by call() for the request it belongs to.
+     */
+    using ReplyHandler = std::function<void(LSMessageToken token, const char *payload)>;
+
+    Handle();
+    explicit Handle(const char *name);
+    ~Handle();
+
+    Handle(const Handle &) = delete;
+    Handle &operator=(const Handle &) = delete;
+
+    LSHandle *get() const { return mHandle; }
+
+    void registerCategory(const char *category, const LSMethod *methods,
+                          const void *signals, const void *properties);
+    void setCategoryData(const char *category, void *data);
+
+    void setReplyHandler(ReplyHandler handler);
+
+    /**
+     * Dispatch payload to the method at uri ("/category/method").
+     * Returns the token of the request, 0 if no such method is registered.
+     */
+    LSMessageToken call(const std::string &uri, const std::string &payload,
+                        const char *sender = "com.webos.service.bench");
+
+    template<typename Class, bool (Class::*MethodPtr)(LSMessage &)>
+    static bool methodWraper(LSHandle *, LSMessage *message, void *context)
+    {
+        return (static_cast<Class *>(context)->*MethodPtr)(*message);
+    }
+
+private:
+    LSHandle *mHandle;
+};
+
+class SubscriptionPoint
+{
+public:
+    SubscriptionPoint() : mHandle(nullptr) {}
+
+    void setServiceHandle(Handle *handle) { mHandle = handle; }
+    bool subscribe(Message &message);
+    bool post(const char *payload);
+    size_t getSubscribersCount() const { return mSubscribers.size(); }
+
+private:
+    Handle *mHandle;
+    std::vector<Message> mSubscribers;
+};
+
+} // namespace LS
+
+#endif
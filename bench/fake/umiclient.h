@@ -0,0 +1,83 @@
+// Copyright (c) 2018 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+
+/**
+ * @file umiclient.h
+ *
+ * @brief umiClient without audio hardware: every call succeeds or fails
+ * at a configurable rate after a configurable delay. Benchmarks only.
+ */
+#ifndef FAKE_UMICLIENT_H
+#define FAKE_UMICLIENT_H
+
+#include <atomic>
+
+typedef int SpeakerVolume;
+
+#define MAX_VOLUME 100
+#define MIN_VOLUME 0
+
+typedef enum {
+    UMI_ERROR_FAIL = -1,
+    UMI_ERROR_NONE = 0
+} UMI_ERROR;
+
+typedef enum {
+    UMI_AUDIO_RESOURCE_NO_CONNECTION = -1,
+    UMI_AUDIO_RESOURCE_MIXER0 = 0
+} UMI_AUDIO_RESOURCE_T;
+
+typedef enum {
+    UMI_AUDIO_NO_OUTPUT = 0,
+    UMI_AUDIO_AMIXER
+} UMI_AUDIO_SNDOUT_T;
+
+class umiClient
+{
+public:
+    static umiClient* getInstance();
+
+    /**
+     * Delay of every HAL call and the fraction (0..1) of calls that fail.
+     * Set before any traffic is sent.
+     */
+    void configure(unsigned latencyUs, double failureRate);
+
+    unsigned long getCallCount() const { return mCalls; }
+
+    bool initialize();
+    bool deinitialize();
+
+    UMI_ERROR connectInput(UMI_AUDIO_RESOURCE_T resource);
+    UMI_ERROR disconnectInput(UMI_AUDIO_RESOURCE_T resource);
+    UMI_ERROR setMute(UMI_AUDIO_RESOURCE_T resource, bool mute);
+    UMI_ERROR setSoundOutput(UMI_AUDIO_SNDOUT_T soundOut);
+    UMI_ERROR setOutputVolume(UMI_AUDIO_SNDOUT_T soundOut, SpeakerVolume volume);
+    UMI_ERROR setOutputMute(UMI_AUDIO_SNDOUT_T soundOut, bool mute);
+    SpeakerVolume getDefaultVolume();
+
+private:
+    umiClient();
+
+    UMI_ERROR call();
+
+    unsigned mLatencyUs;
+    double mFailureRate;
+    std::atomic<unsigned long> mCalls;
+};
+
+#endif
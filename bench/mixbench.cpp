@@ -0,0 +1,131 @@
+// Copyright (c) 2018 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+
+/**
+ * @file mixbench.cpp
+ *
+ * @brief Cost per output frame of mixing N inputs with each of the mix
+ * kernels the CPU supports, and of a whole SoftwareMixer period.
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+#include "logging.h"
+#include "dsp/mixkernels.h"
+#include "dsp/softwaremixer.h"
+
+PmLogContext logContext;
+
+static const char* const logContextName = "audiooutputd-bench";
+static const unsigned int inputCounts[] = { 1, 2, 4, 8, 16, 32 };
+
+template<typename Func>
+static double measure(int iterations, size_t frames, Func func)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++)
+    {
+        func();
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+
+    return std::chrono::duration<double, std::nano>(elapsed).count() / iterations / frames;
+}
+
+int main(int argc, char **argv)
+{
+    int iterations = (argc > 1) ? atoi(argv[1]) : 20000;
+    if (iterations <= 0)
+    {
+        std::cerr << "usage: " << argv[0] << " [iterations]" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    if (kPmLogErr_None != PmLogGetContext(logContextName, &logContext))
+    {
+        std::cerr << "Failed to setup up log context " << logContextName << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    MixerFormat format;
+    size_t samples = format.periodFrames * format.channels;
+    unsigned int maxInputs = inputCounts[sizeof(inputCounts) / sizeof(inputCounts[0]) - 1];
+
+    // Same pseudo random content whatever the kernels
+    std::vector<int16_t> input(samples * maxInputs);
+    unsigned int seed = 1;
+    for (int16_t& sample: input)
+    {
+        seed = seed * 1103515245 + 12345;
+        sample = static_cast<int16_t>(seed >> 16);
+    }
+
+    std::vector<float> accumulator(samples);
+    std::vector<int16_t> output(samples);
+
+    for (unsigned int inputs: inputCounts)
+    {
+        double scalar = 0.0;
+
+        for (const MixKernels* kernels: getSupportedMixKernels())
+        {
+            double nsPerFrame = measure(iterations, format.periodFrames, [&]()
+            {
+                std::fill(accumulator.begin(), accumulator.end(), 0.0f);
+                for (unsigned int i = 0; i < inputs; i++)
+                {
+                    kernels->accumulate(accumulator.data(), input.data() + i * samples, samples, 0.5f);
+                }
+                kernels->convert(output.data(), accumulator.data(), samples);
+            });
+
+            if (kernels == getSupportedMixKernels().front())
+                scalar = nsPerFrame;
+
+            std::cout << inputs << " inputs, " << kernels->name << ": " << nsPerFrame << " ns/frame, "
+                      << scalar / nsPerFrame << "x scalar" << std::endl;
+        }
+    }
+
+    // Queueing included, every input is fed a period per period
+    for (unsigned int inputs: inputCounts)
+    {
+        SoftwareMixer mixer(std::unique_ptr<PcmSink>(new NullPcmSink()), format);
+        std::vector<int> ids;
+
+        for (unsigned int i = 0; i < inputs; i++)
+        {
+            ids.push_back(mixer.addInput());
+        }
+
+        double nsPerFrame = measure(iterations, format.periodFrames, [&]()
+        {
+            for (unsigned int i = 0; i < inputs; i++)
+            {
+                mixer.write(ids[i], input.data() + i * samples, format.periodFrames);
+            }
+            mixer.mixPeriod();
+        });
+
+        std::cout << inputs << " inputs, software mixer (" << mixer.getKernels().name << "): "
+                  << nsPerFrame << " ns/frame" << std::endl;
+    }
+
+    return EXIT_SUCCESS;
+}
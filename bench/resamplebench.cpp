@@ -0,0 +1,90 @@
+// Copyright (c) 2018 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+
+/**
+ * @file resamplebench.cpp
+ *
+ * @brief Cost per input frame and latency of the resampler kernels the CPU
+ * supports, for every conversion between 44.1, 48 and 96 kHz on a stereo
+ * stream fed a mixer period at a time.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+#include "dsp/resampler.h"
+
+static const unsigned int rates[] = { 44100, 48000, 96000 };
+static const unsigned int channels = 2;
+static const size_t periodMs = 10;
+
+int main(int argc, char **argv)
+{
+    int iterations = (argc > 1) ? atoi(argv[1]) : 5000;
+    if (iterations <= 0)
+    {
+        std::cerr << "usage: " << argv[0] << " [iterations]" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    for (unsigned int inputRate: rates)
+    {
+        size_t periodFrames = inputRate * periodMs / 1000;
+        std::vector<float> input(periodFrames * channels);
+        unsigned int seed = 1;
+
+        for (float& sample: input)
+        {
+            seed = seed * 1103515245 + 12345;
+            sample = static_cast<int16_t>(seed >> 16);
+        }
+
+        for (unsigned int outputRate: rates)
+        {
+            if (outputRate == inputRate)
+                continue;
+
+            double scalar = 0.0;
+            for (const ResampleKernels* kernels: getSupportedResampleKernels())
+            {
+                // History carries from period to period as in the mixer
+                Resampler resampler(inputRate, outputRate, channels, *kernels);
+                std::vector<float> output(resampler.getMaxOutputFrames(periodFrames) * channels);
+
+                auto start = std::chrono::steady_clock::now();
+                for (int i = 0; i < iterations; i++)
+                {
+                    resampler.process(input.data(), periodFrames, output.data());
+                }
+                auto elapsed = std::chrono::steady_clock::now() - start;
+                double nsPerFrame = std::chrono::duration<double, std::nano>(elapsed).count() / iterations / periodFrames;
+
+                if (kernels == getSupportedResampleKernels().front())
+                    scalar = nsPerFrame;
+
+                std::cout << inputRate << " to " << outputRate << " Hz, " << kernels->name << ": "
+                          << nsPerFrame << " ns/frame, " << scalar / nsPerFrame << "x scalar, "
+                          << resampler.getLatencyUs() << " us latency" << std::endl;
+            }
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
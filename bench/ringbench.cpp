@@ -0,0 +1,198 @@
+// Copyright (c) 2018 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+
+/**
+ * @file ringbench.cpp
+ *
+ * @brief Throughput and jitter of PcmRingBuffer with 1 to N producer and
+ * consumer thread pairs, each pair on its own ring, private or memfd
+ * backed. Every period pushed is timestamped and the time it took to come
+ * out on the consumer side is its latency, whose spread is the jitter.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include "logging.h"
+#include "dsp/pcmringbuffer.h"
+
+PmLogContext logContext;
+
+static const char* const logContextName = "audiooutputd-bench";
+static const unsigned int channels = 2;
+static const size_t periodFrames = 480;
+static const size_t ringFrames = 8 * periodFrames;
+
+// Empty polls before a thread gives its CPU away
+static const int spinsBeforeYield = 64;
+
+typedef std::chrono::steady_clock Clock;
+
+struct PairResult
+{
+    double framesPerSecond;
+    std::vector<double> latenciesUs;
+    uint32_t overruns;
+    uint32_t underruns;
+};
+
+static void waitABit(int& spins)
+{
+    if (++spins >= spinsBeforeYield)
+    {
+        std::this_thread::yield();
+        spins = 0;
+    }
+}
+
+static PairResult runPair(bool shared, size_t periods)
+{
+    std::unique_ptr<PcmRingBuffer> consumerSide = shared ? PcmRingBuffer::createShared(ringFrames, channels)
+                                                         : PcmRingBuffer::create(ringFrames, channels);
+    if (!consumerSide)
+    {
+        std::cerr << "Failed to create a ring" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    // A second mapping of a shared ring, as a client process would have
+    std::unique_ptr<PcmRingBuffer> producerMapping = shared ? PcmRingBuffer::attach(consumerSide->getFd()) : nullptr;
+    PcmRingBuffer* producerSide = shared ? producerMapping.get() : consumerSide.get();
+
+    // Written before the period is pushed, read after it is popped
+    std::vector<Clock::time_point> pushTimes(periods);
+    PairResult result;
+    result.latenciesUs.reserve(periods);
+
+    auto start = Clock::now();
+
+    std::thread producer([&]()
+    {
+        std::vector<int16_t> period(periodFrames * channels, 1);
+        int spins = 0;
+
+        for (size_t i = 0; i < periods; i++)
+        {
+            size_t pushed = 0;
+
+            pushTimes[i] = Clock::now();
+            while (pushed < periodFrames)
+            {
+                size_t count = producerSide->push(period.data() + pushed * channels, periodFrames - pushed);
+                if (!count)
+                    waitABit(spins);
+                pushed += count;
+            }
+        }
+    });
+
+    std::vector<int16_t> period(periodFrames * channels);
+    size_t popped = 0;
+    int spins = 0;
+
+    for (size_t i = 0; i < periods; )
+    {
+        size_t count = consumerSide->pop(period.data() + popped * channels, periodFrames - popped);
+        if (!count)
+            waitABit(spins);
+
+        popped += count;
+        if (popped == periodFrames)
+        {
+            result.latenciesUs.push_back(std::chrono::duration<double, std::micro>(Clock::now() - pushTimes[i]).count());
+            popped = 0;
+            i++;
+        }
+    }
+
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    producer.join();
+
+    result.framesPerSecond = periods * periodFrames / seconds;
+    result.overruns = consumerSide->getOverruns();
+    result.underruns = consumerSide->getUnderruns();
+    return result;
+}
+
+static double percentile(std::vector<double>& sorted, double fraction)
+{
+    return sorted[std::min(sorted.size() - 1, static_cast<size_t>(fraction * sorted.size()))];
+}
+
+int main(int argc, char **argv)
+{
+    int periods = (argc > 1) ? atoi(argv[1]) : 100000;
+    unsigned int maxPairs = std::max(1u, std::thread::hardware_concurrency() / 2);
+
+    if (periods <= 0)
+    {
+        std::cerr << "usage: " << argv[0] << " [periods]" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    if (kPmLogErr_None != PmLogGetContext(logContextName, &logContext))
+    {
+        std::cerr << "Failed to setup up log context " << logContextName << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    for (bool shared: { false, true })
+    {
+        for (unsigned int pairs = 1; pairs <= maxPairs; pairs *= 2)
+        {
+            std::vector<PairResult> results(pairs);
+            std::vector<std::thread> threads;
+
+            for (unsigned int pair = 0; pair < pairs; pair++)
+            {
+                threads.emplace_back([&results, pair, shared, periods]()
+                {
+                    results[pair] = runPair(shared, periods);
+                });
+            }
+            for (std::thread& thread: threads)
+            {
+                thread.join();
+            }
+
+            double framesPerSecond = 0.0;
+            uint64_t overruns = 0;
+            uint64_t underruns = 0;
+            std::vector<double> latencies;
+
+            for (PairResult& result: results)
+            {
+                framesPerSecond += result.framesPerSecond;
+                overruns += result.overruns;
+                underruns += result.underruns;
+                latencies.insert(latencies.end(), result.latenciesUs.begin(), result.latenciesUs.end());
+            }
+            std::sort(latencies.begin(), latencies.end());
+
+            std::cout << (shared ? "memfd" : "private") << ", " << pairs << " pairs: "
+                      << framesPerSecond / 1e6 << " Mframes/s, latency us p50 " << percentile(latencies, 0.5)
+                      << " p99 " << percentile(latencies, 0.99) << " max " << latencies.back()
+                      << ", " << overruns << " overruns, " << underruns << " underruns" << std::endl;
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
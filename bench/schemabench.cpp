@@ -0,0 +1,117 @@
+// Copyright (c) 2018 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+/**
+ * @file schemabench.cpp
+ *
+ * @brief Per-call cost of validating a request payload against a schema
+ * compiled on every call versus one taken from LSUtils::SchemaRegistry,
+ * and of decoding it with LSUtils::FieldDecoder instead.
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include "utils.h"
+
+static const char* const setSchema = STRICT_SCHEMA(PROPS_2(PROP(soundOutput, string), PROP(volume, integer))
+                                                   REQUIRED_2(soundOutput, volume));
+static const std::string setPayload = "{\"soundOutput\":\"alsa\",\"volume\":42}";
+static const std::string invalidPayload = "{\"soundOutput\":\"alsa\",\"volume\":\"42\"}";
+static const std::string rampPayload =
+    "{\"soundOutput\":\"alsa\",\"volume\":42,\"ramp\":{\"duration\":200}}";
+static const char* const setSchemaWithRamp =
+    STRICT_SCHEMA(PROPS_3(PROP(soundOutput, string), PROP(volume, integer), OBJECT(ramp, OBJSCHEMA_1(PROP(duration, integer))))
+                  REQUIRED_2(soundOutput, volume));
+
+template<typename Func>
+static double measure(const char *name, int iterations, Func func)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++)
+    {
+        if (!func())
+        {
+            std::cerr << name << ": payload rejected" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    double nsPerCall = std::chrono::duration<double, std::nano>(elapsed).count() / iterations;
+
+    std::cout << name << ": " << nsPerCall << " ns/call" << std::endl;
+    return nsPerCall;
+}
+
+int main(int argc, char **argv)
+{
+    int iterations = (argc > 1) ? atoi(argv[1]) : 100000;
+    if (iterations <= 0)
+    {
+        std::cerr << "usage: " << argv[0] << " [iterations]" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    LSUtils::SchemaRegistry schemas;
+    schemas.add("set", setSchema);
+
+    double perCall = measure("compiled per call", iterations, []() {
+        pbnjson::JValue requestObj;
+        int parseError = 0;
+        return LSUtils::parsePayload(setPayload, requestObj, std::string(setSchema), &parseError);
+    });
+
+    double cached = measure("cached in registry", iterations, [&schemas]() {
+        pbnjson::JValue requestObj;
+        LSUtils::ParseError parseError;
+        return LSUtils::parsePayload(setPayload, requestObj, schemas.get("set"), &parseError);
+    });
+
+    std::cout << "speedup: " << perCall / cached << "x" << std::endl;
+
+    double decoded = measure("field decoder", iterations, [&schemas]() {
+        pbnjson::JValue requestObj;
+        LSUtils::ParseError parseError;
+        std::string soundOutput;
+        int volume = 0;
+        LSUtils::FieldDecoder fields;
+        fields.string("soundOutput", soundOutput).integer("volume", volume);
+        return LSUtils::parsePayload(setPayload.c_str(), fields, requestObj, schemas.get("set"), &parseError) &&
+               volume == 42;
+    });
+
+    std::cout << "decoder speedup: " << cached / decoded << "x" << std::endl;
+
+    schemas.add("setWithRamp", setSchemaWithRamp);
+    measure("field decoder fallback", iterations, [&schemas]() {
+        pbnjson::JValue requestObj;
+        LSUtils::ParseError parseError;
+        std::string soundOutput;
+        int volume = 0;
+        LSUtils::FieldDecoder fields;
+        fields.string("soundOutput", soundOutput).integer("volume", volume);
+        return LSUtils::parsePayload(rampPayload.c_str(), fields, requestObj, schemas.get("setWithRamp"), &parseError) &&
+               volume == 42;
+    });
+
+    measure("rejected payload", iterations, [&schemas]() {
+        pbnjson::JValue requestObj;
+        LSUtils::ParseError parseError;
+        return !LSUtils::parsePayload(invalidPayload, requestObj, schemas.get("set"), &parseError);
+    });
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,247 @@
+// Copyright (c) 2018 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+
+/**
+ * @file servicebench.cpp
+ *
+ * @brief Replays recorded Luna requests through AudioService and
+ * VolumeService, linked against the in-process luna-service2 and umiClient
+ * of bench/fake, and reports throughput and latency per method as JSON.
+ *
+ * Each line of the replay file is "<uri> <payload>", '#' starts a comment.
+ * Requests are sent one at a time; the latency of a request runs from its
+ * dispatch to its response, including the HAL call and the main loop
+ * iterations needed to deliver its completion.
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <vector>
+#include "logging.h"
+#include "stats.h"
+#include "utils.h"
+#include "audio/audioservice.h"
+#include "audio/halexecutor.h"
+#include "audio/volumeservice.h"
+#include "dsp/softwaremixer.h"
+#include "statestore.h"
+
+PmLogContext logContext;
+
+static const char* const logContextName = "audiooutputd-bench";
+static const char* const serviceName = "com.webos.service.audiooutput";
+static const guint replyTimeoutMs = 5000;
+
+static gint option_iterations = 1000;
+static gint option_hal_latency = 0;
+static gdouble option_failure_rate = 0.0;
+static gint option_hal_workers = 1;
+static gint option_volume_window = 30;
+
+static GOptionEntry options[] = {
+        { "iterations", 'n', 0, G_OPTION_ARG_INT, &option_iterations,
+                "Number of times the replay file is sent", "N"},
+        { "hal-latency", 'l', 0, G_OPTION_ARG_INT, &option_hal_latency,
+                "Duration of every HAL call in microseconds", "US"},
+        { "failure-rate", 'f', 0, G_OPTION_ARG_DOUBLE, &option_failure_rate,
+                "Fraction of HAL calls that fail, 0 to 1", "RATE"},
+        { "hal-workers", 'j', 0, G_OPTION_ARG_INT, &option_hal_workers,
+                "Number of threads running HAL calls (0 runs them on the main loop)", "N"},
+        { "volume-window", 'w', 0, G_OPTION_ARG_INT, &option_volume_window,
+                "Merge volume up/down requests arriving within MS into one HAL write (0 disables)", "MS"},
+        { NULL, ' ', 0, G_OPTION_ARG_NONE, NULL, NULL, NULL },
+};
+
+struct Request
+{
+    std::string uri;
+    std::string payload;
+};
+
+static bool loadReplay(const char *path, std::vector<Request> &requests)
+{
+    std::ifstream file(path);
+    std::string line;
+
+    if (!file)
+    {
+        std::cerr << "Cannot open " << path << std::endl;
+        return false;
+    }
+
+    while (std::getline(file, line))
+    {
+        if (line.empty() || '#' == line[0])
+        {
+            continue;
+        }
+
+        std::string::size_type space = line.find(' ');
+        if (std::string::npos == space)
+        {
+            std::cerr << "Malformed replay line: " << line << std::endl;
+            return false;
+        }
+
+        requests.push_back(Request{line.substr(0, space), line.substr(space + 1)});
+    }
+
+    return !requests.empty();
+}
+
+static gboolean onReplyTimeout(gpointer data)
+{
+    *static_cast<bool*>(data) = true;
+    return G_SOURCE_REMOVE;
+}
+
+int main(int argc, char **argv)
+{
+    GOptionContext *context = g_option_context_new("[REPLAY-FILE]");
+    GError *err = NULL;
+
+    g_option_context_add_main_entries(context, options, NULL);
+    if (!g_option_context_parse(context, &argc, &argv, &err))
+    {
+        std::cerr << (err ? err->message : "Invalid arguments") << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    g_option_context_free(context);
+
+    if (option_iterations <= 0 || option_hal_latency < 0 || option_hal_workers < 0 ||
+        option_volume_window < 0 || option_failure_rate < 0.0 || option_failure_rate > 1.0)
+    {
+        std::cerr << "Invalid option value, see --help" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    std::vector<Request> requests;
+    if (!loadReplay(argc > 1 ? argv[1] : BENCH_REPLAY_FILE, requests))
+    {
+        exit(EXIT_FAILURE);
+    }
+
+    if (kPmLogErr_None != PmLogGetContext(logContextName, &logContext))
+    {
+        std::cerr << "Failed to setup up log context " << logContextName << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    umiClient* umi = umiClient::getInstance();
+    umi->configure(option_hal_latency, option_failure_rate);
+
+    std::map<std::string, LatencyStats> methods;
+    unsigned long updates = 0;
+    std::chrono::steady_clock::duration elapsed;
+
+    {
+        LS::Handle service(serviceName);
+        HalExecutor halExecutor(option_hal_workers);
+        // As in main(), requests arriving early are held until UMI is up
+        halExecutor.initialize("initialize",
+                               [umi]() { return umi->initialize() ? UMI_ERROR_NONE : UMI_ERROR_FAIL; },
+                               nullptr);
+        // Nothing saved, every run starts from the defaults
+        StateStore stateStore("");
+        VolumeService volumeService(service, umi, halExecutor, stateStore, OutputRegistry::getDefaultConfig(),
+                                    option_volume_window);
+        SoftwareMixer mixer(std::unique_ptr<PcmSink>(new NullPcmSink()));
+        AudioService audioService(service, volumeService, umi, halExecutor, stateStore, mixer);
+
+        // Tokens grow with every request and only one is in flight, so any
+        // later post for an answered token is a subscription update
+        LSMessageToken answered = 0;
+        std::string reply;
+        std::chrono::steady_clock::time_point replied;
+
+        service.setReplyHandler([&](LSMessageToken token, const char *payload) {
+            if (token <= answered)
+            {
+                updates++;
+                return;
+            }
+            replied = std::chrono::steady_clock::now();
+            reply = payload;
+            answered = token;
+        });
+
+        auto start = std::chrono::steady_clock::now();
+
+        for (int i = 0; i < option_iterations; i++)
+        {
+            for (const Request &request: requests)
+            {
+                bool timedOut = false;
+                guint timeout = g_timeout_add(replyTimeoutMs, onReplyTimeout, &timedOut);
+
+                auto sent = std::chrono::steady_clock::now();
+                LSMessageToken token = service.call(request.uri, request.payload);
+                if (!token)
+                {
+                    std::cerr << "No such method: " << request.uri << std::endl;
+                    exit(EXIT_FAILURE);
+                }
+
+                while (answered != token && !timedOut)
+                {
+                    g_main_context_iteration(nullptr, TRUE);
+                }
+
+                if (timedOut)
+                {
+                    std::cerr << "No response to " << request.uri << " " << request.payload << std::endl;
+                    exit(EXIT_FAILURE);
+                }
+                g_source_remove(timeout);
+
+                pbnjson::JValue response;
+                bool failed = !LSUtils::parsePayload(reply, response) || !response["returnValue"].asBool();
+
+                methods[request.uri].record(replied - sent, failed);
+            }
+        }
+
+        elapsed = std::chrono::steady_clock::now() - start;
+    }
+
+    double seconds = std::chrono::duration<double>(elapsed).count();
+    pbnjson::JValue result = pbnjson::Object();
+    pbnjson::JValue methodsObj = pbnjson::Array();
+
+    for (const auto &method: methods)
+    {
+        methodsObj.append(method.second.toJson(method.first));
+    }
+
+    result.put("iterations", option_iterations);
+    result.put("requests", static_cast<int64_t>(option_iterations * requests.size()));
+    result.put("elapsedMs", seconds * 1000.0);
+    result.put("requestsPerSecond", option_iterations * requests.size() / seconds);
+    result.put("subscriptionPosts", static_cast<int64_t>(updates));
+    result.put("halCalls", static_cast<int64_t>(umi->getCallCount()));
+    result.put("methods", methodsObj);
+    result.put("service", Stats::instance().toJson());
+
+    std::string output;
+    LSUtils::generatePayload(result, output);
+    std::cout << output << std::endl;
+
+    return EXIT_SUCCESS;
+}
@@ -17,31 +17,36 @@
 #include "logging.h"
 #include "amixercontroller.h"
 
-AmixerController::AmixerController(umiClient* umiInstance)
-                   :umi(umiInstance)
+AmixerController::AmixerController(umiClient* umiInstance, HalExecutor& executor, UMI_AUDIO_SNDOUT_T output)
+                   :IVolumeController(executor, HalExecutor::outputKey(output))
+                   ,umi(umiInstance)
+                   ,mOutput(output)
 {}
 
 AmixerController::~AmixerController() {}
 
-bool AmixerController::onVolumeChanged()
+bool AmixerController::applyVolume(SpeakerVolume volume)
 {
-    if ( (nullptr == umi) || umi->setOutputVolume(UMI_AUDIO_AMIXER, getVolume()) != UMI_ERROR_NONE)
+    SpeakerVolume level = toHalLevel(volume);
+
+    if ( (nullptr == umi) || umi->setOutputVolume(mOutput, level) != UMI_ERROR_NONE)
     {
-        LOG_ERROR(MSGID_CONFIG_VOLUME_ERROR, 0, "Failed set Amixer volume to %d", getVolume());
+        LOG_ERROR(MSGID_CONFIG_VOLUME_ERROR, 0, "Failed set Amixer output %d volume to %d (level %d)", mOutput,
+                  volume, level);
         return false;
     }
 
-    LOG_DEBUG("Amixer volume changed to %d", getVolume());
+    LOG_DEBUG("Amixer output %d volume changed to %d (level %d)", mOutput, volume, level);
     return true;
 }
 
-bool AmixerController::onMuteChanged()
+bool AmixerController::applyMute(bool muted)
 {
-    if( (nullptr == umi) || umi->setOutputMute(UMI_AUDIO_AMIXER, getMute()) != UMI_ERROR_NONE)
+    if( (nullptr == umi) || umi->setOutputMute(mOutput, muted) != UMI_ERROR_NONE)
     {
-        LOG_ERROR(MSGID_CONFIG_VOLUME_ERROR, 0, "Failed set Amixer mute to %d", getMute());
+        LOG_ERROR(MSGID_CONFIG_VOLUME_ERROR, 0, "Failed set Amixer output %d mute to %d", mOutput, muted);
         return false;
     }
-    LOG_DEBUG("Amixer mute changed to %d", getMute());
+    LOG_DEBUG("Amixer output %d mute changed to %d", mOutput, muted);
     return true;
 }
@@ -24,16 +24,17 @@ class AmixerController : public IVolumeController
 {
 private:
     umiClient* umi=nullptr;
+    UMI_AUDIO_SNDOUT_T mOutput;
 
 public:
-    AmixerController(umiClient* umiInstance);
+    AmixerController(umiClient* umiInstance, HalExecutor& executor, UMI_AUDIO_SNDOUT_T output);
     ~AmixerController();
 
     AmixerController(const AmixerController &) = delete;
     AmixerController &operator=(const AmixerController &) = delete;
 
 protected:
-    bool onVolumeChanged() override;
-    bool onMuteChanged() override;
+    bool applyVolume(SpeakerVolume volume) override;
+    bool applyMute(bool muted) override;
 };
 #endif
@@ -0,0 +1,142 @@
+// Copyright (c) 2018 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+
+/**
+ * @file audioroutes.h
+ *
+ * @brief Names accepted by the audio API and the UMI resources behind them
+ *
+ */
+#ifndef AUDIO_ROUTES_H
+#define AUDIO_ROUTES_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <umiclient.h>
+
+/**
+ * Sources, sinks and soundOuts are referred to by small ids, the index of
+ * their name in the tables below. The tables are sorted by name so that a
+ * name is found by binary search, at compile time for the route table.
+ * Supporting a new connection or output is adding a table entry.
+ */
+namespace AudioRoutes {
+
+typedef uint8_t Id;
+
+const Id INVALID_ID = 0xff;
+
+struct Endpoint
+{
+    const char *name;
+};
+
+struct SoundOut
+{
+    const char *name;
+    UMI_AUDIO_SNDOUT_T resource;
+};
+
+struct Route
+{
+    Id source;
+    Id sink;
+    UMI_AUDIO_RESOURCE_T resource;
+};
+
+constexpr int compare(const char *a, const char *b)
+{
+    return (*a != *b || !*a) ? (*a < *b ? -1 : (*a > *b ? 1 : 0)) : compare(a + 1, b + 1);
+}
+
+template<typename Entry, size_t N>
+constexpr bool isSorted(const Entry (&table)[N], size_t i = 1)
+{
+    return i >= N || (compare(table[i - 1].name, table[i].name) < 0 && isSorted(table, i + 1));
+}
+
+/**
+ * Index of name in a table sorted by name, INVALID_ID if absent.
+ */
+template<typename Entry, size_t N>
+constexpr Id find(const Entry (&table)[N], const char *name, size_t low = 0, size_t high = N)
+{
+    return (low >= high) ? INVALID_ID
+        : (compare(name, table[(low + high) / 2].name) < 0) ? find(table, name, low, (low + high) / 2)
+        : (compare(name, table[(low + high) / 2].name) > 0) ? find(table, name, (low + high) / 2 + 1, high)
+        : static_cast<Id>((low + high) / 2);
+}
+
+constexpr Endpoint SOURCES[] = {
+    { "AMIXER" },
+};
+
+constexpr Endpoint SINKS[] = {
+    { "ALSA" },
+};
+
+constexpr SoundOut SOUND_OUTS[] = {
+    { "alsa", UMI_AUDIO_AMIXER },
+};
+
+// Connections on these routes are mixed by the HAL, or in process by the
+// software mixer when connect asks for it, which takes any number of inputs
+constexpr Route ROUTES[] = {
+    { find(SOURCES, "AMIXER"), find(SINKS, "ALSA"), UMI_AUDIO_RESOURCE_MIXER0 },
+};
+
+static_assert(isSorted(SOURCES), "SOURCES must be sorted by name");
+static_assert(isSorted(SINKS), "SINKS must be sorted by name");
+static_assert(isSorted(SOUND_OUTS), "SOUND_OUTS must be sorted by name");
+
+constexpr bool areRoutesValid(size_t i = 0)
+{
+    return i >= sizeof(ROUTES) / sizeof(ROUTES[0]) ||
+           (ROUTES[i].source != INVALID_ID && ROUTES[i].sink != INVALID_ID && areRoutesValid(i + 1));
+}
+
+static_assert(areRoutesValid(), "ROUTES refers to an unknown source or sink");
+
+/**
+ * UMI input connecting source to sink, UMI_AUDIO_RESOURCE_NO_CONNECTION if none.
+ */
+constexpr UMI_AUDIO_RESOURCE_T getResource(Id source, Id sink, size_t i = 0)
+{
+    return (i >= sizeof(ROUTES) / sizeof(ROUTES[0])) ? UMI_AUDIO_RESOURCE_NO_CONNECTION
+        : (ROUTES[i].source == source && ROUTES[i].sink == sink) ? ROUTES[i].resource
+        : getResource(source, sink, i + 1);
+}
+
+inline Id getSourceId(const std::string &name)
+{
+    return find(SOURCES, name.c_str());
+}
+
+inline Id getSinkId(const std::string &name)
+{
+    return find(SINKS, name.c_str());
+}
+
+inline Id getSoundOutId(const std::string &name)
+{
+    return find(SOUND_OUTS, name.c_str());
+}
+
+} // namespace AudioRoutes
+
+#endif
@@ -14,23 +14,81 @@
 //
 // SPDX-License-Identifier: Apache-2.0
 
+#include <map>
 #include "logging.h"
 #include "audioservice.h"
 
+// Fields of the flat requests, decoded by LSUtils::FieldDecoder
+struct ConnectionParams
+{
+    std::string source;
+    std::string sink;
+    std::string mixer;
+    bool mute = false;
+};
+
+// Values of the mixer parameter of connect
+static const char* const halMixer = "hal";
+static const char* const softwareMixer = "software";
+
+struct SoundOutParams
+{
+    std::string soundOut;
+};
+
 AudioService::AudioService(LS::Handle &handle,VolumeService& volumeService,
-                           umiClient* umiInstance)
+                           umiClient* umiInstance, HalExecutor& halExecutor, StateStore& stateStore,
+                           SoftwareMixer& mixer)
         : mVolumeService(volumeService)
         , mService(&handle)
         , umi(umiInstance)
+        , mHalExecutor(halExecutor)
+        , mStateStore(stateStore)
+        , mMixer(mixer)
 {
+    mStatusSubscription.setServiceHandle(mService);
+
     LS_CREATE_CATEGORY_BEGIN(AudioService, audio)
-    LS_CATEGORY_METHOD(connect)
-    LS_CATEGORY_METHOD(disconnect)
-    LS_CATEGORY_METHOD(getStatus)
-    LS_CATEGORY_METHOD(mute)
-    LS_CATEGORY_METHOD(setSoundOut)
+    LS_CATEGORY_TIMED_METHOD(applyBatch)
+    LS_CATEGORY_TIMED_METHOD(connect)
+    LS_CATEGORY_TIMED_METHOD(disconnect)
+    LS_CATEGORY_TIMED_METHOD(getStatus)
+    LS_CATEGORY_TIMED_METHOD(getStats)
+    LS_CATEGORY_TIMED_METHOD(mute)
+    LS_CATEGORY_TIMED_METHOD(setSoundOut)
     LS_CREATE_CATEGORY_END
 
+    mSchemas.add("applyBatch", STRICT_SCHEMA(PROPS_1(OBJARRAY(operations,
+                                                              OBJSCHEMA_7(PROP(method, string),
+                                                                          PROP(source, string),
+                                                                          PROP(sink, string),
+                                                                          PROP(mute, boolean),
+                                                                          PROP(soundOut, string),
+                                                                          PROP(soundOutput, string),
+                                                                          PROP(volume, integer))))
+                                             REQUIRED_1(operations)));
+    mSchemas.add("connect", STRICT_SCHEMA(PROPS_3(PROP(source, string), PROP(sink, string), PROP(mixer, string))
+                                          REQUIRED_2(source, sink)));
+    mSchemas.add("disconnect", STRICT_SCHEMA(PROPS_2(PROP(sink, string), PROP(source, string))
+                                             REQUIRED_2(source, sink)));
+    mSchemas.add("getStatus", STRICT_SCHEMA(PROPS_1(PROP(subscribe, boolean))));
+    mSchemas.add("getStats", STRICT_SCHEMA(PROPS_1(PROP(reset, boolean))));
+    mSchemas.add("mute", STRICT_SCHEMA(PROPS_3(PROP(source, string), PROP(sink, string), PROP(mute, boolean))
+                                       REQUIRED_3(source, sink, mute)));
+    mSchemas.add("setSoundOut", STRICT_SCHEMA(PROPS_1(PROP(soundOut, string)) REQUIRED_1(soundOut)));
+
+    // The software mix goes through a copy of the equalizer of its output
+    mVolumeService.setEqualizerHandler([this](AudioOutput& output)
+    {
+        if (mMixer.getEqualizer() == &output.equalizer)
+        {
+            mMixer.setEqualizer(&output.equalizer);
+        }
+    });
+
+    restoreState();
+    mStateStore.addSection("audio", [this]() { return buildState(); });
+
     try
     {
         mService->registerCategory("/audio", LS_CATEGORY_TABLE_NAME(audio), nullptr, nullptr);
@@ -45,80 +103,68 @@ AudioService::AudioService(LS::Handle &handle,VolumeService& volumeService,
 
 AudioService::~AudioService()
 {
+    // Saved before tearing the connections down, they are made again on start
+    mStateStore.removeSection("audio");
+    mVolumeService.setEqualizerHandler(nullptr);
+
     for (auto& connection: mConnections)
     {
-        doDisconnectAudio(connection);
+        doDisconnectAudio(connection.second, nullptr);
     }
     mConnections.clear();
 }
 
-bool AudioService::isValidSource(std::string& source)
+bool AudioService::getConnectionKey(const std::string& source, const std::string& sink,
+                                    AudioConnectionKey& key)
 {
-    if ( "AMIXER" == source)
-        return true;
-    else
-        return false;
-}
+    AudioRoutes::Id sourceId = AudioRoutes::getSourceId(source);
+    AudioRoutes::Id sinkId = AudioRoutes::getSinkId(sink);
 
-bool AudioService::isValidSink(std::string& sink)
-{
-    if ( "ALSA" == sink )
-        return true;
-    else
+    if (AudioRoutes::INVALID_ID == sourceId || AudioRoutes::INVALID_ID == sinkId)
         return false;
-}
-
-UMI_AUDIO_RESOURCE_T AudioService::getResourceId(std::string& source, std::string& sink)
-{
-    if ("AMIXER" == source && "ALSA" == sink)
-        return UMI_AUDIO_RESOURCE_MIXER0; // TODO - Mixer Inputs to be enhanced
-    else
-        return UMI_AUDIO_RESOURCE_NO_CONNECTION;
-}
-
-UMI_AUDIO_SNDOUT_T AudioService::getSoundOutResourceId(std::string& soundOut)
-{
-    //TODO - Soundoutputs to be enhanced
 
-    if  ("alsa" == soundOut)
-        return UMI_AUDIO_AMIXER;
-    else
-        return UMI_AUDIO_NO_OUTPUT;
+    key = makeConnectionKey(sourceId, sinkId);
+    return true;
 }
 
 bool AudioService::connect(LSMessage& message)
 {
     LS::Message request(&message);
     pbnjson::JValue requestObj;
-    int parseError = 0;
+    LSUtils::ParseError parseError;
 
     std::string sinkName;
     std::string sourceName;
 
     UMI_AUDIO_RESOURCE_T audioResourceId;
+    AudioConnectionKey key;
 
-    const std::string schema = STRICT_SCHEMA(PROPS_2(PROP(source, string),PROP(sink, string))
-                                             REQUIRED_2(source, sink));
+    ConnectionParams params;
+    LSUtils::FieldDecoder fields;
+    fields.string("source", params.source).string("sink", params.sink).string("mixer", params.mixer, false);
 
-    if (!LSUtils::parsePayload(request.getPayload(), requestObj, schema, &parseError))
+    if (!LSUtils::parsePayload(request.getPayload(), fields, requestObj, mSchemas.get("connect"), &parseError))
     {
-        LSUtils::respondWithError(request, errorSchemavalidation, API_ERROR_SCHEMA_VALIDATION);
+        LSUtils::respondWithError(request, parseError);
         return true;
     }
 
-    sinkName = requestObj["sink"].asString();
-    sourceName = requestObj["source"].asString();
+    sinkName = std::move(params.sink);
+    sourceName = std::move(params.source);
 
     LOG_DEBUG("Audio connect request for source %s, sink %s",
                sourceName.c_str(), sinkName.c_str());
 
-    if (!isValidSource(sourceName) || !isValidSink(sinkName))
+    bool softwareMix = (softwareMixer == params.mixer);
+    bool knownMixer = params.mixer.empty() || softwareMix || halMixer == params.mixer;
+
+    if (!getConnectionKey(sourceName, sinkName, key) || !knownMixer)
     {
         LSUtils::respondWithError(request, errorInvalidParameters, API_ERROR_INVALID_PARAMETERS);
         return true;
     }
 
-    audioResourceId = getResourceId(sourceName, sinkName);
+    audioResourceId = AudioRoutes::getResource(getConnectionSource(key), getConnectionSink(key));
 
     if (UMI_AUDIO_RESOURCE_NO_CONNECTION == audioResourceId)
     {
@@ -127,64 +173,438 @@ bool AudioService::connect(LSMessage& message)
         return true;
     }
 
-    AudioConnection* connection = findAudioConnection(sourceName, sinkName);
-    if (!connection)
+    // An existing connection keeps its mixer, asking for the other one is
+    // an error rather than a silent success
+    AudioConnection* existing = findAudioConnection(key);
+    if (existing && !params.mixer.empty() && softwareMix != (SoftwareMixer::INVALID_INPUT != existing->mixerInput))
     {
-        connection = &(*mConnections.emplace(mConnections.end(), AudioConnection()));
-        connection->sink = sinkName;
-        connection->source = sourceName;
-        connection->audioResourceId = audioResourceId;
+        LSUtils::respondWithError(request, errorConnectionNotPossible, API_ERROR_CONNECTION_NOT_POSSIBLE);
+        return true;
     }
 
-    UMI_ERROR success = (nullptr != umi) ? umi->connectInput(connection->audioResourceId):
-                                           UMI_ERROR_FAIL;
+    doConnectAudio(key, audioResourceId, softwareMix, [request, key, softwareMix](bool success) mutable
+    {
+        if (!success)
+        {
+            // Only the HAL fails a HAL connection, a software one fails
+            // for want of a mixer input
+            if (softwareMix)
+                LSUtils::respondWithError(request, errorConnectionNotPossible, API_ERROR_CONNECTION_NOT_POSSIBLE);
+            else
+                LSUtils::respondWithError(request, errorHALError, API_ERROR_HAL_ERROR);
+            return;
+        }
 
-    pbnjson::JValue responseObj = pbnjson::Object();
+        LOG_DEBUG("Audio connect success");
+        LSUtils::postToClient(request, LSUtils::ResponseWriter::instance().begin(true)
+                                           .add("source", AudioRoutes::SOURCES[getConnectionSource(key)].name)
+                                           .add("sink", AudioRoutes::SINKS[getConnectionSink(key)].name)
+                                           .end());
+    });
+
+    return true;
+}
+
+bool AudioService::applyBatch(LSMessage& message)
+{
+    LS::Message request(&message);
+    pbnjson::JValue requestObj;
+    LSUtils::ParseError parseError;
 
-    if (success == UMI_ERROR_NONE)
+    if (!LSUtils::parsePayload(request.getPayload(), requestObj, mSchemas.get("applyBatch"), &parseError))
     {
-        LOG_DEBUG("Audio connect success");
-        responseObj.put("returnValue", true);
-        responseObj.put("source", sourceName);
-        responseObj.put("sink", sinkName);
+        LSUtils::respondWithError(request, parseError);
+        return true;
     }
-    else
+
+    pbnjson::JValue operations = requestObj["operations"];
+    auto transaction = Transaction::create();
+    std::vector<int> stepOperations;
+    int errorCode = 0;
+    std::string errorText;
+
+    int invalidOperation = planBatch(operations, *transaction, stepOperations, errorCode, errorText);
+    if (invalidOperation >= 0)
     {
-        removeAudioConnection(sourceName, sinkName);
-        responseObj.put("returnValue", false);
-        responseObj.put("errorText", errorHALError);
-        responseObj.put("errorCode", API_ERROR_HAL_ERROR);
+        respondBatch(request, operations, invalidOperation, errorCode, errorText);
+        return true;
     }
-    LSUtils::postToClient(request, responseObj);
+
+    LOG_DEBUG("Audio applyBatch of %d operations in %zu HAL steps", static_cast<int>(operations.arraySize()),
+              transaction->size());
+
+    transaction->run([this, request, operations, stepOperations](int failedStep) mutable
+    {
+        if (failedStep < 0)
+            respondBatch(request, operations, -1, 0, std::string());
+        else
+            respondBatch(request, operations, stepOperations[failedStep], API_ERROR_HAL_ERROR, errorHALError);
+    });
 
     return true;
 }
 
+int AudioService::planBatch(const pbnjson::JValue& operations, Transaction& transaction,
+                            std::vector<int>& stepOperations, int& errorCode, std::string& errorText)
+{
+    struct ConnectionPlan
+    {
+        bool connected;
+        bool muted;
+        UMI_AUDIO_RESOURCE_T resourceId;
+        int operation;
+    };
+
+    struct OutputPlan
+    {
+        SpeakerVolume volume;
+        bool muted;
+        int volumeOperation;
+        int muteOperation;
+    };
+
+    // Final state of everything the operations touch
+    std::map<AudioConnectionKey, ConnectionPlan> connections;
+    std::map<AudioOutput*, OutputPlan> outputs;
+    AudioRoutes::Id soundOutId = AudioRoutes::INVALID_ID;
+    int soundOutOperation = -1;
+
+    auto planConnection = [this, &connections](AudioConnectionKey key) -> ConnectionPlan&
+    {
+        auto iter = connections.find(key);
+        if (iter == connections.end())
+        {
+            AudioConnection* connection = findAudioConnection(key);
+            ConnectionPlan plan{connection != nullptr, connection && connection->muted,
+                                connection ? connection->audioResourceId : UMI_AUDIO_RESOURCE_NO_CONNECTION, -1};
+            iter = connections.emplace(key, plan).first;
+        }
+        return iter->second;
+    };
+
+    auto planOutput = [this, &outputs](AudioOutput* output) -> OutputPlan&
+    {
+        auto iter = outputs.find(output);
+        if (iter == outputs.end())
+        {
+            OutputPlan plan{mVolumeService.getTargetVolume(*output), output->userMute, -1, -1};
+            iter = outputs.emplace(output, plan).first;
+        }
+        return iter->second;
+    };
+
+    auto fail = [&errorCode, &errorText](int index, int code, const std::string& text)
+    {
+        errorCode = code;
+        errorText = text;
+        return index;
+    };
+
+    for (int index = 0; index < static_cast<int>(operations.arraySize()); index++)
+    {
+        pbnjson::JValue operation = operations[index];
+        std::string method = operation["method"].asString();
+
+        if ("connect" == method || "disconnect" == method || "mute" == method)
+        {
+            AudioConnectionKey key;
+
+            if (!operation.hasKey("source") || !operation.hasKey("sink") ||
+                ("mute" == method && !operation.hasKey("mute")))
+                return fail(index, API_ERROR_INVALID_PARAMETERS, errorInvalidParameters);
+
+            bool known = getConnectionKey(operation["source"].asString(), operation["sink"].asString(), key);
+
+            if ("connect" == method)
+            {
+                if (!known)
+                    return fail(index, API_ERROR_INVALID_PARAMETERS, errorInvalidParameters);
+
+                UMI_AUDIO_RESOURCE_T resourceId = AudioRoutes::getResource(getConnectionSource(key),
+                                                                           getConnectionSink(key));
+                if (UMI_AUDIO_RESOURCE_NO_CONNECTION == resourceId)
+                    return fail(index, API_ERROR_CONNECTION_NOT_POSSIBLE, errorConnectionNotPossible);
+
+                ConnectionPlan& plan = planConnection(key);
+                if (!plan.connected)
+                {
+                    plan = ConnectionPlan{true, false, resourceId, index};
+                }
+                continue;
+            }
+
+            if (!known || !planConnection(key).connected)
+                return fail(index, API_ERROR_AUDIO_NOT_CONNECTED, errorAudioNotConnected);
+
+            ConnectionPlan& plan = planConnection(key);
+            if ("disconnect" == method)
+                plan.connected = false;
+            else
+                plan.muted = operation["mute"].asBool();
+            plan.operation = index;
+        }
+        else if ("setSoundOut" == method)
+        {
+            if (!operation.hasKey("soundOut"))
+                return fail(index, API_ERROR_INVALID_PARAMETERS, errorInvalidParameters);
+
+            soundOutId = AudioRoutes::getSoundOutId(operation["soundOut"].asString());
+            if (AudioRoutes::INVALID_ID == soundOutId)
+                return fail(index, API_ERROR_NOT_IMPLEMENTED, errorNotImplemented);
+            soundOutOperation = index;
+        }
+        else if ("volume/set" == method || "volume/muteSoundOut" == method)
+        {
+            bool isSet = ("volume/set" == method);
+
+            if (!operation.hasKey("soundOutput") || !operation.hasKey(isSet ? "volume" : "mute"))
+                return fail(index, API_ERROR_INVALID_PARAMETERS, errorInvalidParameters);
+
+            AudioOutput* output = mVolumeService.findOutput(operation["soundOutput"].asString());
+            if (!output)
+                return fail(index, API_ERROR_INVALID_VOLUME_CONTROL, errorInvalidVolumeControl);
+
+            OutputPlan& plan = planOutput(output);
+            if (isSet)
+            {
+                int volume = operation["volume"].asNumber<int>();
+                if (volume > MAX_VOLUME || volume < MIN_VOLUME)
+                    return fail(index, API_ERROR_VOLUME_LIMIT, errorVolumeLimit);
+
+                plan.volume = volume;
+                plan.volumeOperation = index;
+            }
+            else
+            {
+                plan.muted = operation["mute"].asBool();
+                plan.muteOperation = index;
+            }
+        }
+        else
+        {
+            return fail(index, API_ERROR_NOT_IMPLEMENTED, errorNotImplemented);
+        }
+    }
+
+    auto addStep = [&transaction, &stepOperations](int operation, Transaction::Action apply,
+                                                   Transaction::Action undo)
+    {
+        transaction.add(std::move(apply), std::move(undo));
+        stepOperations.push_back(operation);
+    };
+
+    // Connections first, routing and mutes apply to them, disconnections last
+    for (auto& iter: connections)
+    {
+        AudioConnectionKey key = iter.first;
+        ConnectionPlan& plan = iter.second;
+
+        if (plan.connected && !findAudioConnection(key))
+        {
+            UMI_AUDIO_RESOURCE_T resourceId = plan.resourceId;
+
+            addStep(plan.operation,
+                    [this, key, resourceId](Transaction::Done done) { doConnectAudio(key, resourceId, false, done); },
+                    [this, key](Transaction::Done done)
+                    {
+                        AudioConnection* connection = findAudioConnection(key);
+                        if (!connection)
+                            return done(true);
+                        notifyStatus(*connection, false);
+                        doDisconnectAudio(*connection, [done](UMI_ERROR result) { done(UMI_ERROR_NONE == result); });
+                        removeAudioConnection(key);
+                    });
+        }
+    }
+
+    if (soundOutOperation >= 0)
+    {
+        AudioRoutes::Id previousId = mConnections.empty() ? AudioRoutes::INVALID_ID
+                                                          : mConnections.begin()->second.outputMode;
+        bool routed = !mConnections.empty();
+
+        for (auto& connection: mConnections)
+            routed = routed && connection.second.outputMode == soundOutId;
+
+        if (!routed)
+        {
+            Transaction::Action undo;
+            if (AudioRoutes::INVALID_ID != previousId)
+                undo = [this, previousId](Transaction::Done done) { doSetSoundOut(previousId, done); };
+
+            addStep(soundOutOperation,
+                    [this, soundOutId](Transaction::Done done) { doSetSoundOut(soundOutId, done); },
+                    undo);
+        }
+    }
+
+    for (auto& iter: connections)
+    {
+        AudioConnectionKey key = iter.first;
+        ConnectionPlan& plan = iter.second;
+        AudioConnection* connection = findAudioConnection(key);
+        bool muted = plan.muted;
+
+        if (!plan.connected || muted == (connection && connection->muted))
+            continue;
+
+        // Used for the rollback as well, so that subscribers see both
+        auto setMute = [this, key](bool muted, Transaction::Done done)
+        {
+            AudioConnection* connection = findAudioConnection(key);
+            if (!connection)
+                return done(false);
+
+            bool changed = (connection->muted != muted);
+            doMuteAudio(key, *connection, muted, [this, key, changed, done](bool success)
+            {
+                AudioConnection* connection = (success && changed) ? findAudioConnection(key) : nullptr;
+                if (connection)
+                    notifyStatus(*connection, true);
+                done(success);
+            });
+        };
+
+        addStep(plan.operation,
+                [setMute, muted](Transaction::Done done) { setMute(muted, done); },
+                [setMute, muted](Transaction::Done done) { setMute(!muted, done); });
+    }
+
+    for (auto& iter: outputs)
+    {
+        AudioOutput* output = iter.first;
+        OutputPlan& plan = iter.second;
+        SpeakerVolume volume = plan.volume;
+        SpeakerVolume previousVolume = mVolumeService.getTargetVolume(*output);
+        bool muted = plan.muted;
+
+        if (volume != previousVolume)
+        {
+            addStep(plan.volumeOperation,
+                    [this, output, volume](Transaction::Done done)
+                    {
+                        mVolumeService.setVolume(*output, volume, done);
+                    },
+                    [this, output, previousVolume](Transaction::Done done)
+                    {
+                        mVolumeService.setVolume(*output, previousVolume, done);
+                    });
+        }
+
+        if (muted != output->userMute)
+        {
+            addStep(plan.muteOperation,
+                    [this, output, muted](Transaction::Done done) { mVolumeService.setMute(*output, muted, done); },
+                    [this, output, muted](Transaction::Done done) { mVolumeService.setMute(*output, !muted, done); });
+        }
+    }
+
+    for (auto& iter: connections)
+    {
+        AudioConnectionKey key = iter.first;
+        AudioConnection* connection = findAudioConnection(key);
+
+        if (iter.second.connected || !connection)
+            continue;
+
+        UMI_AUDIO_RESOURCE_T resourceId = connection->audioResourceId;
+        bool wasMuted = connection->muted;
+        bool softwareMix = (SoftwareMixer::INVALID_INPUT != connection->mixerInput);
+
+        addStep(iter.second.operation,
+                [this, key](Transaction::Done done)
+                {
+                    AudioConnection* connection = findAudioConnection(key);
+                    if (!connection)
+                        return done(true);
+
+                    // Unlike disconnect, kept on failure so that the batch can be rolled back
+                    doDisconnectAudio(*connection, [this, key, done](UMI_ERROR result)
+                    {
+                        AudioConnection* connection = findAudioConnection(key);
+                        if (UMI_ERROR_NONE == result && connection)
+                        {
+                            notifyStatus(*connection, false);
+                            removeAudioConnection(key);
+                        }
+                        done(UMI_ERROR_NONE == result);
+                    });
+                },
+                [this, key, resourceId, wasMuted, softwareMix](Transaction::Done done)
+                {
+                    doConnectAudio(key, resourceId, softwareMix, [this, key, wasMuted, done](bool success)
+                    {
+                        AudioConnection* connection = findAudioConnection(key);
+                        if (!success || !wasMuted || !connection)
+                            return done(success);
+                        doMuteAudio(key, *connection, true, done);
+                    });
+                });
+    }
+
+    return -1;
+}
+
+void AudioService::respondBatch(LS::Message& request, const pbnjson::JValue& operations, int failedOperation,
+                                int errorCode, const std::string& errorText)
+{
+    pbnjson::JArray results;
+    pbnjson::JValue responseObj = pbnjson::Object();
+
+    // All or nothing: after a failure no operation is left applied
+    for (int index = 0; index < static_cast<int>(operations.arraySize()); index++)
+    {
+        pbnjson::JValue result = pbnjson::Object();
+
+        result.put("method", operations[index]["method"]);
+        result.put("returnValue", failedOperation < 0);
+        if (index == failedOperation)
+        {
+            result.put("errorText", errorText);
+            result.put("errorCode", errorCode);
+        }
+        results.append(result);
+    }
+
+    responseObj.put("returnValue", failedOperation < 0);
+    if (failedOperation >= 0)
+    {
+        responseObj.put("errorText", errorText);
+        responseObj.put("errorCode", errorCode);
+        responseObj.put("failedOperation", failedOperation);
+    }
+    responseObj.put("results", results);
+
+    LSUtils::postToClient(request, responseObj);
+}
+
 bool AudioService::disconnect(LSMessage& message)
 {
     LS::Message request(&message);
     pbnjson::JValue requestObj;
-    int parseError = 0;
+    LSUtils::ParseError parseError;
 
     std::string sinkName;
     std::string sourceName;
+    AudioConnectionKey key;
 
-    const std::string schema = STRICT_SCHEMA(PROPS_2(PROP(sink, string), PROP(source, string))
-                                             REQUIRED_2(source, sink));
+    ConnectionParams params;
+    LSUtils::FieldDecoder fields;
+    fields.string("source", params.source).string("sink", params.sink);
 
-    if (!LSUtils::parsePayload(request.getPayload(), requestObj, schema, &parseError))
+    if (!LSUtils::parsePayload(request.getPayload(), fields, requestObj, mSchemas.get("disconnect"), &parseError))
     {
-        LSUtils::respondWithError(request, errorSchemavalidation, API_ERROR_SCHEMA_VALIDATION);
+        LSUtils::respondWithError(request, parseError);
         return true;
     }
 
-    sinkName = requestObj["sink"].asString();
-    sourceName = requestObj["source"].asString();
+    sinkName = std::move(params.sink);
+    sourceName = std::move(params.source);
 
     LOG_DEBUG("Audio disconnect request for source %s, sink %s",
                sourceName.c_str(), sinkName.c_str());
 
-    AudioConnection* connection = findAudioConnection(sourceName, sinkName);
+    AudioConnection* connection = getConnectionKey(sourceName, sinkName, key) ? findAudioConnection(key) : nullptr;
 
     if (!connection)
     {
@@ -192,27 +612,27 @@ bool AudioService::disconnect(LSMessage& message)
         return true;
     }
 
-    UMI_ERROR success = doDisconnectAudio(*connection);
+    doDisconnectAudio(*connection, [request, key](UMI_ERROR success) mutable
+    {
+        const char* source = AudioRoutes::SOURCES[getConnectionSource(key)].name;
+        const char* sink = AudioRoutes::SINKS[getConnectionSink(key)].name;
 
-    removeAudioConnection(sourceName, sinkName);
+        if (success != UMI_ERROR_NONE)
+        {
+            LSUtils::respondWithError(request, errorHALError, API_ERROR_HAL_ERROR);
+            return;
+        }
 
-    pbnjson::JValue responseObj = pbnjson::Object();
+        LOG_DEBUG("Audio disconnect with source %s and sink %s", source, sink);
+        LSUtils::postToClient(request, LSUtils::ResponseWriter::instance().begin(true)
+                                           .add("source", source)
+                                           .add("sink", sink)
+                                           .end());
+    });
 
-    if (success == UMI_ERROR_NONE)
-    {
-        LOG_DEBUG("Audio disconnect with source %s and sink %s", sourceName.c_str(),
-                  sinkName.c_str());
-        responseObj.put("returnValue", true);
-        responseObj.put("source", sourceName);
-        responseObj.put("sink", sinkName);
-    }
-    else
-    {
-        responseObj.put("returnValue", false);
-        responseObj.put("errorText", errorHALError);
-        responseObj.put("errorCode", API_ERROR_HAL_ERROR);
-    }
-    LSUtils::postToClient(request, responseObj);
+    // The connection is gone whatever the HAL says
+    notifyStatus(*connection, false);
+    removeAudioConnection(key);
     return true;
 }
 
@@ -220,50 +640,44 @@ bool AudioService::setSoundOut(LSMessage& message)
 {
     LS::Message request(&message);
     pbnjson::JValue requestObj;
-    int parseError = 0;
+    LSUtils::ParseError parseError;
 
     std::string soundOut;
 
-    const std::string schema = STRICT_SCHEMA(PROPS_1(PROP(soundOut, string)) REQUIRED_1(soundOut));
+    SoundOutParams params;
+    LSUtils::FieldDecoder fields;
+    fields.string("soundOut", params.soundOut);
 
-    if (!LSUtils::parsePayload(request.getPayload(), requestObj, schema, &parseError))
+    if (!LSUtils::parsePayload(request.getPayload(), fields, requestObj, mSchemas.get("setSoundOut"), &parseError))
     {
-        LSUtils::respondWithError(request, errorSchemavalidation, API_ERROR_SCHEMA_VALIDATION);
+        LSUtils::respondWithError(request, parseError);
         return true;
     }
 
-    soundOut = requestObj["soundOut"].asString();
+    soundOut = std::move(params.soundOut);
 
     LOG_DEBUG("Audio setSoundOut request for soundOut %s",soundOut.c_str());
 
-    UMI_AUDIO_SNDOUT_T soundOutResourceId = getSoundOutResourceId(soundOut);
+    AudioRoutes::Id soundOutId = AudioRoutes::getSoundOutId(soundOut);
 
-    if (UMI_AUDIO_NO_OUTPUT == soundOutResourceId)
+    if (AudioRoutes::INVALID_ID == soundOutId)
     {
         LSUtils::respondWithError(request, errorNotImplemented, API_ERROR_NOT_IMPLEMENTED);
         return true;
     }
 
-    pbnjson::JValue responseObj = pbnjson::Object();
-
-    if ( (nullptr != umi) && umi->setSoundOutput(soundOutResourceId) == UMI_ERROR_NONE)
-    {
-        LOG_DEBUG("Audio routing to soundOut %s  is success", soundOut.c_str());
-
-        for (AudioConnection& connection: mConnections)
-            connection.outputMode = soundOut;
-
-        responseObj.put("returnValue", true);
-        responseObj.put("soundOut", soundOut);
-    }
-    else
+    doSetSoundOut(soundOutId, [request, soundOutId](bool success) mutable
     {
-        responseObj.put("returnValue", false);
-        responseObj.put("errorText", errorHALError);
-        responseObj.put("errorCode", API_ERROR_HAL_ERROR);
-    }
+        if (!success)
+        {
+            LSUtils::respondWithError(request, errorHALError, API_ERROR_HAL_ERROR);
+            return;
+        }
 
-    LSUtils::postToClient(request, responseObj);
+        LSUtils::postToClient(request, LSUtils::ResponseWriter::instance().begin(true)
+                                           .add("soundOut", AudioRoutes::SOUND_OUTS[soundOutId].name)
+                                           .end());
+    });
 
     return true;
 }
@@ -272,29 +686,31 @@ bool AudioService::mute(LSMessage& message)
 {
     LS::Message request(&message);
     pbnjson::JValue requestObj;
-    int parseError = 0;
+    LSUtils::ParseError parseError;
 
     std::string sinkName;
     std::string sourceName;
     bool muted = false;
+    AudioConnectionKey key;
 
-    const std::string schema = STRICT_SCHEMA(PROPS_3(PROP(source, string),PROP(sink, string),
-                                             PROP(mute, boolean)) REQUIRED_3(source, sink, mute));
+    ConnectionParams params;
+    LSUtils::FieldDecoder fields;
+    fields.string("source", params.source).string("sink", params.sink).boolean("mute", params.mute);
 
-    if (!LSUtils::parsePayload(request.getPayload(), requestObj, schema, &parseError))
+    if (!LSUtils::parsePayload(request.getPayload(), fields, requestObj, mSchemas.get("mute"), &parseError))
     {
-        LSUtils::respondWithError(request, errorSchemavalidation, API_ERROR_SCHEMA_VALIDATION);
+        LSUtils::respondWithError(request, parseError);
         return true;
     }
 
-    sinkName = requestObj["sink"].asString();
-    sourceName = requestObj["source"].asString();
-    muted = requestObj["mute"].asBool();
+    sinkName = std::move(params.sink);
+    sourceName = std::move(params.source);
+    muted = params.mute;
 
     LOG_DEBUG("Audio mute called for source %s, sink %s, mute %d",
                sourceName.c_str(), sinkName.c_str(), muted);
 
-    AudioConnection* connection = findAudioConnection(sourceName, sinkName);
+    AudioConnection* connection = getConnectionKey(sourceName, sinkName, key) ? findAudioConnection(key) : nullptr;
 
     if (!connection)
     {
@@ -302,55 +718,212 @@ bool AudioService::mute(LSMessage& message)
         return true;
     }
 
-    pbnjson::JValue responseObj = pbnjson::Object();
+    // Subscribers only hear of actual changes
+    bool changed = (connection->muted != muted);
 
-    if (!doMuteAudio(*connection, muted))
+    doMuteAudio(key, *connection, muted, [this, request, key, muted, changed](bool success) mutable
     {
-        responseObj.put("returnValue", false);
-        responseObj.put("errorText", errorHALError);
-        responseObj.put("errorCode", API_ERROR_HAL_ERROR);
+        if (!success)
+        {
+            LSUtils::respondWithError(request, errorHALError, API_ERROR_HAL_ERROR);
+            return;
+        }
+
+        AudioConnection* connection = changed ? findAudioConnection(key) : nullptr;
+        if (connection)
+            notifyStatus(*connection, true);
+
+        // After notifying, which may use the writer too
+        LSUtils::postToClient(request, LSUtils::ResponseWriter::instance().begin(true)
+                                           .add("sink", AudioRoutes::SINKS[getConnectionSink(key)].name)
+                                           .add("source", AudioRoutes::SOURCES[getConnectionSource(key)].name)
+                                           .add("mute", muted)
+                                           .end());
+    });
+
+    return true;
+}
+
+bool AudioService::getStatus(LSMessage& message)
+{
+    LS::Message request(&message);
+    pbnjson::JValue requestObj;
+    LSUtils::ParseError parseError;
+
+    if (!LSUtils::parsePayload(request.getPayload(), requestObj, mSchemas.get("getStatus"), &parseError))
+    {
+        LSUtils::respondWithError(request, parseError);
+        return true;
     }
-    else
+
+    bool subscribed = request.isSubscription();
+
+    if (subscribed && !mStatusSubscription.subscribe(request))
     {
-        responseObj.put("returnValue", true);
-        responseObj.put("sink", sinkName);
-        responseObj.put("source", sourceName);
-        responseObj.put("mute", muted);
+        LSUtils::respondWithError(request, errorUnknown, API_ERROR_UNKNOWN, true);
+        return true;
     }
 
-    LSUtils::postToClient(request, responseObj);
+    LSUtils::postToClient(request, getStatusPayload(subscribed));
 
     return true;
 }
 
-bool AudioService::getStatus(LSMessage& message)
+bool AudioService::getStats(LSMessage& message)
 {
     LS::Message request(&message);
     pbnjson::JValue requestObj;
-    int parseError = 0;
-
-    const std::string schema = STRICT_SCHEMA(PROPS_0());
+    LSUtils::ParseError parseError;
 
-    if (!LSUtils::parsePayload(request.getPayload(), requestObj, schema, &parseError))
+    if (!LSUtils::parsePayload(request.getPayload(), requestObj, mSchemas.get("getStats"), &parseError))
     {
-        LSUtils::respondWithError(request, errorSchemavalidation, API_ERROR_SCHEMA_VALIDATION);
+        LSUtils::respondWithError(request, parseError);
         return true;
     }
 
-    pbnjson::JValue response = this->buildStatus();
+    pbnjson::JValue responseObj = Stats::instance().toJson();
+    responseObj.put("rateLimits", RateLimiter::instance().toJson());
+    responseObj.put("mixer", mMixer.toJson());
+    responseObj.put("returnValue", true);
 
-    LSUtils::postToClient(request, response);
+    if (requestObj["reset"].asBool())
+    {
+        Stats::instance().reset();
+        RateLimiter::instance().reset();
+    }
+
+    LSUtils::postToClient(request, responseObj);
 
     return true;
 }
 
+const std::string& AudioService::getStatusPayload(bool subscribed)
+{
+    std::string& payload = mStatusPayload[subscribed];
+
+    if (payload.empty())
+    {
+        pbnjson::JValue response = this->buildStatus();
+        if (subscribed)
+        {
+            response.put("subscribed", true);
+        }
+        LSUtils::generatePayload(response, payload);
+    }
+
+    return payload;
+}
+
+void AudioService::invalidateStatus()
+{
+    mStatusPayload[false].clear();
+    mStatusPayload[true].clear();
+    mStateStore.markDirty();
+}
+
+void AudioService::restoreState()
+{
+    pbnjson::JValue saved = mStateStore.getSaved("audio");
+    AudioRoutes::Id soundOutId = AudioRoutes::INVALID_ID;
+
+    if (!saved.isObject() || !saved["connections"].isArray())
+        return;
+
+    pbnjson::JValue connections = saved["connections"];
+    for (int index = 0; index < static_cast<int>(connections.arraySize()); index++)
+    {
+        pbnjson::JValue connection = connections[index];
+        AudioConnectionKey key;
+        std::string source = connection["source"].asString();
+        std::string sink = connection["sink"].asString();
+
+        if (!getConnectionKey(source, sink, key))
+        {
+            LOG_WARNING(MSGID_STATE_LOAD_ERROR, 0, "Not restoring unknown connection %s to %s",
+                        source.c_str(), sink.c_str());
+            continue;
+        }
+
+        UMI_AUDIO_RESOURCE_T resourceId = AudioRoutes::getResource(getConnectionSource(key),
+                                                                   getConnectionSink(key));
+        if (UMI_AUDIO_RESOURCE_NO_CONNECTION == resourceId)
+            continue;
+
+        bool softwareMix = (softwareMixer == connection["mixer"].asString());
+
+        doConnectAudio(key, resourceId, softwareMix, [source, sink](bool success)
+        {
+            if (!success)
+                LOG_ERROR(MSGID_HAL_ERROR, 0, "Failed to restore connection %s to %s",
+                          source.c_str(), sink.c_str());
+        });
+
+        // Queued behind connectInput on the same resource
+        AudioConnection* restored = findAudioConnection(key);
+        if (restored && connection["muted"].asBool())
+            doMuteAudio(key, *restored, true, [](bool) {});
+
+        if (connection.hasKey("outputMode"))
+            soundOutId = AudioRoutes::getSoundOutId(connection["outputMode"].asString());
+    }
+
+    if (AudioRoutes::INVALID_ID != soundOutId)
+    {
+        doSetSoundOut(soundOutId, [](bool success)
+        {
+            if (!success)
+                LOG_ERROR(MSGID_HAL_ERROR, 0, "Failed to restore the sound output");
+        });
+    }
+}
+
+pbnjson::JValue AudioService::buildState()
+{
+    pbnjson::JArray connections;
+    pbnjson::JValue state = pbnjson::Object();
+
+    for (auto& iter: mConnections)
+    {
+        const AudioConnection& c = iter.second;
+        pbnjson::JValue connection = pbnjson::Object();
+
+        connection.put("source", AudioRoutes::SOURCES[c.source].name);
+        connection.put("sink", AudioRoutes::SINKS[c.sink].name);
+        connection.put("muted", c.muted);
+        connection.put("mixer", (SoftwareMixer::INVALID_INPUT != c.mixerInput) ? softwareMixer : halMixer);
+        if (AudioRoutes::INVALID_ID != c.outputMode)
+            connection.put("outputMode", AudioRoutes::SOUND_OUTS[c.outputMode].name);
+        connections.append(connection);
+    }
+    state.put("connections", connections);
+
+    return state;
+}
+
+void AudioService::notifyStatus(const AudioConnection& connection, bool connected)
+{
+    // Updates only carry the connection that changed; "connected" tells
+    // subscribers whether to add/update or to drop it from their list.
+    pbnjson::JArray array;
+    pbnjson::JValue responseObj = pbnjson::Object();
+    pbnjson::JValue connectionObj = buildAudioStatus(connection);
+
+    connectionObj.put("connected", connected);
+    array.append(connectionObj);
+    responseObj.put("returnValue", true);
+    responseObj.put("subscribed", true);
+    responseObj.put("audio", array);
+
+    LSUtils::postToSubscriptionPoint(&mStatusSubscription, responseObj);
+}
+
 pbnjson::JValue AudioService::buildStatus()
 {
     pbnjson::JArray array;
     pbnjson::JValue responseObj = pbnjson::Object();
-    for (AudioConnection& connection: mConnections)
+    for (auto& connection: mConnections)
     {
-        array.append(buildAudioStatus(connection));
+        array.append(buildAudioStatus(connection.second));
     }
     responseObj.put("returnValue", true);
     responseObj.put("audio", array);
@@ -361,62 +934,191 @@ pbnjson::JValue AudioService::buildAudioStatus(const AudioConnection& c)
 {
     pbnjson::JValue responseObj = pbnjson::Object();
 
-    responseObj.put("sink", c.sink);
-    responseObj.put("source", c.source);
-    if (c.outputMode.empty())
+    responseObj.put("sink", AudioRoutes::SINKS[c.sink].name);
+    responseObj.put("source", AudioRoutes::SOURCES[c.source].name);
+    if (AudioRoutes::INVALID_ID == c.outputMode)
       responseObj.put("outputMode", "null");
     else
-      responseObj.put("outputMode", c.outputMode);
+      responseObj.put("outputMode", AudioRoutes::SOUND_OUTS[c.outputMode].name);
     responseObj.put("muted", c.muted);
+    responseObj.put("mixer", (SoftwareMixer::INVALID_INPUT != c.mixerInput) ? softwareMixer : halMixer);
 
     return responseObj;
 }
 
-AudioConnection* AudioService::findAudioConnection(const std::string& source,
-                                                       const std::string& sink)
+AudioConnection* AudioService::findAudioConnection(AudioConnectionKey key)
 {
-    for (auto iter = mConnections.begin(); iter != mConnections.end(); iter ++)
+    auto iter = mConnections.find(key);
+    return (iter != mConnections.end()) ? &iter->second : nullptr;
+}
+
+void AudioService::removeAudioConnection(AudioConnectionKey key)
+{
+    if (mConnections.erase(key))
     {
-        AudioConnection& connection = *iter;
-        if (connection.source == source && connection.sink == sink)
+        invalidateStatus();
+    }
+}
+
+void AudioService::doConnectAudio(AudioConnectionKey key, UMI_AUDIO_RESOURCE_T resourceId, bool softwareMix,
+                                  std::function<void(bool)> done)
+{
+    auto inserted = mConnections.emplace(key, AudioConnection());
+    AudioConnection& connection = inserted.first->second;
+    if (inserted.second)
+    {
+        connection.sink = getConnectionSink(key);
+        connection.source = getConnectionSource(key);
+        connection.audioResourceId = resourceId;
+        if (softwareMix)
         {
-            return &connection;
+            connection.mixerInput = mMixer.addInput();
+            if (SoftwareMixer::INVALID_INPUT == connection.mixerInput)
+            {
+                // Not turned into a HAL connection behind the caller's back
+                mConnections.erase(inserted.first);
+                done(false);
+                return;
+            }
         }
+        invalidateStatus();
+    }
+
+    // Mixed in process, the HAL input is left alone
+    if (SoftwareMixer::INVALID_INPUT != connection.mixerInput)
+    {
+        notifyStatus(connection, true);
+        done(true);
+        return;
     }
-    return nullptr;
+
+    auto onConnected = [this, key, done](UMI_ERROR result)
+    {
+        bool success = (UMI_ERROR_NONE == result);
+        // Looked up again, a disconnect may have been handled meanwhile
+        AudioConnection* connection = findAudioConnection(key);
+
+        if (success)
+        {
+            if (connection)
+                notifyStatus(*connection, true);
+        }
+        else
+        {
+            removeAudioConnection(key);
+        }
+
+        done(success);
+    };
+
+    submitHalCall(HalExecutor::resourceKey(resourceId), "connectInput",
+                  [resourceId](umiClient* client) { return client->connectInput(resourceId); },
+                  onConnected);
 }
 
-void AudioService::removeAudioConnection(const std::string& source,
-                                             const std::string& sink)
+void AudioService::doSetSoundOut(AudioRoutes::Id soundOutId, std::function<void(bool)> done)
 {
-    for (auto iter = mConnections.begin(); iter != mConnections.end(); iter ++)
+    UMI_AUDIO_SNDOUT_T resourceId = AudioRoutes::SOUND_OUTS[soundOutId].resource;
+
+    auto onRouted = [this, soundOutId, done](UMI_ERROR result)
     {
-        AudioConnection& connection = *iter;
-        if (connection.source == source && connection.sink == sink)
+        bool success = (UMI_ERROR_NONE == result);
+
+        if (success)
         {
-            mConnections.erase(iter);
-            break;
+            LOG_DEBUG("Audio routing to soundOut %s  is success", AudioRoutes::SOUND_OUTS[soundOutId].name);
+
+            for (auto& connection: mConnections)
+            {
+                connection.second.outputMode = soundOutId;
+                notifyStatus(connection.second, true);
+            }
+            invalidateStatus();
+
+            // The software mix follows, through the equalizer of the new
+            // output and resampled to its native rate
+            AudioOutput* output = mVolumeService.findOutput(soundOutId);
+            mMixer.setEqualizer(output ? &output->equalizer : nullptr);
+            mMixer.setOutputRate(output ? output->rate : mMixer.getFormat().rate);
         }
-    }
+
+        done(success);
+    };
+
+    submitHalCall(HalExecutor::routingKey(), "setSoundOutput",
+                  [resourceId](umiClient* client) { return client->setSoundOutput(resourceId); },
+                  onRouted);
 }
 
-UMI_ERROR AudioService::doDisconnectAudio(AudioConnection& connection)
+void AudioService::doDisconnectAudio(const AudioConnection& connection, HalExecutor::Completion done)
 {
-    return ( (nullptr != umi) ?umi->disconnectInput(connection.audioResourceId):UMI_ERROR_FAIL);
+    UMI_AUDIO_RESOURCE_T resourceId = connection.audioResourceId;
+
+    if (SoftwareMixer::INVALID_INPUT != connection.mixerInput)
+    {
+        mMixer.removeInput(connection.mixerInput);
+        if (done)
+            done(UMI_ERROR_NONE);
+        return;
+    }
+
+    submitHalCall(HalExecutor::resourceKey(resourceId), "disconnectInput",
+                  [resourceId](umiClient* client) { return client->disconnectInput(resourceId); },
+                  done);
 }
 
-bool AudioService::doMuteAudio(AudioConnection& connection, bool muted)
+void AudioService::doMuteAudio(AudioConnectionKey key, AudioConnection& connection, bool muted,
+                               std::function<void(bool)> done)
 {
     if (connection.muted == muted)
     {
-        return true;
+        done(true);
+        return;
     }
 
-    if ( (nullptr == umi) || umi->setMute(connection.audioResourceId, muted)!=UMI_ERROR_NONE)
+    // muted tracks the last request, so that a following opposite request
+    // is not mistaken for a no-op while this one is in flight
+    connection.muted = muted;
+    invalidateStatus();
+
+    if (SoftwareMixer::INVALID_INPUT != connection.mixerInput)
     {
-        return false;
+        mMixer.setMuted(connection.mixerInput, muted);
+        done(true);
+        return;
     }
 
-    connection.muted = muted;
-    return true;
+    UMI_AUDIO_RESOURCE_T resourceId = connection.audioResourceId;
+
+    auto onMuted = [this, key, muted, done](UMI_ERROR result)
+    {
+        bool success = (UMI_ERROR_NONE == result);
+
+        if (!success)
+        {
+            AudioConnection* connection = findAudioConnection(key);
+            if (connection && connection->muted == muted)
+            {
+                connection->muted = !muted;
+                invalidateStatus();
+            }
+        }
+
+        done(success);
+    };
+
+    submitHalCall(HalExecutor::resourceKey(resourceId), "setMute",
+                  [resourceId, muted](umiClient* client) { return client->setMute(resourceId, muted); },
+                  onMuted);
+}
+
+void AudioService::submitHalCall(HalExecutor::Key key, const char* name,
+                                 std::function<UMI_ERROR(umiClient*)> call, HalExecutor::Completion done)
+{
+    umiClient* client = umi;
+
+    mHalExecutor.submit(key, name, [client, call]()
+    {
+        return (nullptr != client) ? call(client) : UMI_ERROR_FAIL;
+    }, done);
 }
@@ -17,25 +17,55 @@
 #ifndef AUDIO_SERVICE_H
 #define AUDIO_SERVICE_H
 
+#include <cstdint>
 #include <string>
 #include <unordered_map>
 #include <luna-service2/lunaservice.hpp>
+#include "audioroutes.h"
+#include "transaction.h"
 #include "ivolumecontroller.h"
 #include "volumeservice.h"
+#include "halexecutor.h"
+#include "statestore.h"
+#include "dsp/softwaremixer.h"
 #include <umiclient.h>
 #include "utils.h"
 
 using namespace pbnjson;
 
+/**
+ * Identifies a connection by the ids of its source and sink,
+ * see AudioService::getConnectionKey.
+ */
+typedef uint16_t AudioConnectionKey;
+
+inline AudioConnectionKey makeConnectionKey(AudioRoutes::Id source, AudioRoutes::Id sink)
+{
+    return static_cast<AudioConnectionKey>((source << 8) | sink);
+}
+
+inline AudioRoutes::Id getConnectionSource(AudioConnectionKey key)
+{
+    return static_cast<AudioRoutes::Id>(key >> 8);
+}
+
+inline AudioRoutes::Id getConnectionSink(AudioConnectionKey key)
+{
+    return static_cast<AudioRoutes::Id>(key & 0xff);
+}
+
 class AudioConnection
 {
 public:
     AudioConnection(){};
 
-    std::string source;
-    std::string sink;
-    std::string outputMode;
+    AudioRoutes::Id source = AudioRoutes::INVALID_ID;
+    AudioRoutes::Id sink = AudioRoutes::INVALID_ID;
+    // SOUND_OUTS id, INVALID_ID until routed
+    AudioRoutes::Id outputMode = AudioRoutes::INVALID_ID;
     bool muted = false;
+    // Input of the software mixer, INVALID_INPUT when the HAL mixes
+    int mixerInput = SoftwareMixer::INVALID_INPUT;
 
     UMI_AUDIO_RESOURCE_T audioResourceId = UMI_AUDIO_RESOURCE_NO_CONNECTION;
 };
@@ -44,43 +74,92 @@ class AudioService
 {
 
 public:
+    /**
+     * Connections saved in stateStore are made again before the methods
+     * are registered.
+     */
     AudioService(LS::Handle &handle, VolumeService& volumeService,
-                 umiClient* umiInstance);
+                 umiClient* umiInstance, HalExecutor& halExecutor, StateStore& stateStore,
+                 SoftwareMixer& mixer);
     ~AudioService();
 
     AudioService(const AudioService &) = delete;
     AudioService &operator=(const AudioService &) = delete;
 
     // Audio methods
+    bool applyBatch(LSMessage& message);
     bool connect(LSMessage& message);
     bool disconnect(LSMessage& message);
     bool mute(LSMessage& message);
     bool getStatus(LSMessage& message);
+    bool getStats(LSMessage& message);
     bool setSoundOut(LSMessage& message);
 
 private:
     VolumeService& mVolumeService;
 
-    std::vector<AudioConnection> mConnections;
+    // Node based, so that a connection stays at the same address until it
+    // is itself removed
+    std::unordered_map<AudioConnectionKey, AudioConnection> mConnections;
     LS::Handle *mService;
+    LSUtils::SchemaRegistry mSchemas;
+    LS::SubscriptionPoint mStatusSubscription;
 
     umiClient* umi = nullptr;
+    HalExecutor& mHalExecutor;
+    StateStore& mStateStore;
+    SoftwareMixer& mMixer;
 
-    JValue buildStatus();
-    JValue buildAudioStatus(const AudioConnection& connection);
-
-    bool doMuteAudio(AudioConnection& connection, bool muted);
-    bool isValidSource(std::string& source);
-    bool isValidSink(std::string& sink);
+    // Serialized getStatus replies without and with "subscribed", empty
+    // when state changed since they were built
+    std::string mStatusPayload[2];
 
-    void removeAudioConnection(const std::string& source, const std::string& sink);
+    const std::string& getStatusPayload(bool subscribed);
+    void invalidateStatus();
 
-    AudioConnection* findAudioConnection(const std::string& source, const std::string& sink);
+    void restoreState();
+    JValue buildState();
 
-    UMI_ERROR doDisconnectAudio(AudioConnection& connection);
+    JValue buildStatus();
+    JValue buildAudioStatus(const AudioConnection& connection);
 
-    UMI_AUDIO_RESOURCE_T getResourceId(std::string& source, std::string& sink);
-    UMI_AUDIO_SNDOUT_T getSoundOutResourceId(std::string& soundOut);
+    /**
+     * Checks the operations of an applyBatch request against the state they
+     * would leave and adds to transaction the HAL changes between the current
+     * and the final state, each once. stepOperations gets, for every step,
+     * the last operation asking for it.
+     * Returns the index of the first invalid operation, -1 if all are valid.
+     */
+    int planBatch(const pbnjson::JValue& operations, Transaction& transaction,
+                  std::vector<int>& stepOperations, int& errorCode, std::string& errorText);
+    void respondBatch(LS::Message& request, const pbnjson::JValue& operations, int failedOperation,
+                      int errorCode, const std::string& errorText);
+
+    // Post a changed connection to getStatus subscribers
+    void notifyStatus(const AudioConnection& connection, bool connected);
+
+    void doMuteAudio(AudioConnectionKey key, AudioConnection& connection, bool muted,
+                     std::function<void(bool)> done);
+    // False if source or sink is unknown
+    bool getConnectionKey(const std::string& source, const std::string& sink, AudioConnectionKey& key);
+
+    void removeAudioConnection(AudioConnectionKey key);
+
+    AudioConnection* findAudioConnection(AudioConnectionKey key);
+
+    /**
+     * With softwareMix the connection is an input of the software mixer
+     * rather than of the HAL, failing if the mixer has no input left. An
+     * existing connection keeps its mixer.
+     */
+    void doConnectAudio(AudioConnectionKey key, UMI_AUDIO_RESOURCE_T resourceId, bool softwareMix,
+                        std::function<void(bool)> done);
+    void doDisconnectAudio(const AudioConnection& connection, HalExecutor::Completion done);
+    void doSetSoundOut(AudioRoutes::Id soundOutId, std::function<void(bool)> done);
+
+    // Run a umiClient call on the HAL executor, failing if there is no client
+    void submitHalCall(HalExecutor::Key key, const char* name,
+                       std::function<UMI_ERROR(umiClient*)> call, HalExecutor::Completion done);
 
 };
 #endif
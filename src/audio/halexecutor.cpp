@@ -0,0 +1,186 @@
+// Copyright (c) 2018 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "halexecutor.h"
+
+#include <chrono>
+
+HalExecutor::HalExecutor(unsigned int workers)
+{
+    for (unsigned int i = 0; i < workers; i++)
+    {
+        mWorkers.emplace_back(&HalExecutor::run, this);
+    }
+}
+
+HalExecutor::~HalExecutor()
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStopping = true;
+    }
+    mWorkAvailable.notify_all();
+
+    for (auto& worker : mWorkers)
+    {
+        worker.join();
+    }
+}
+
+void HalExecutor::submit(Key key, const char* name, Call call, Completion done)
+{
+    Job job{std::move(call), std::move(done), &Stats::instance().get(Stats::HAL_CALL, name)};
+
+    if (mWorkers.empty())
+    {
+        UMI_ERROR result = mInitFailed ? UMI_ERROR_FAIL : runJob(job);
+        if (job.done)
+        {
+            job.done(result);
+        }
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        Strand& strand = mStrands[key];
+
+        strand.jobs.push_back(std::move(job));
+        mPending++;
+
+        // An idle strand with one job is not in the ready list yet. The
+        // initialization itself is never held behind itself.
+        if (!strand.busy && strand.jobs.size() == 1)
+        {
+            bool held = mInitializing && makeKey(KEY_INIT, 0) != key;
+            (held ? mHeld : mReady).push_back(key);
+        }
+    }
+    mWorkAvailable.notify_one();
+}
+
+void HalExecutor::initialize(const char* name, Call init, Completion done)
+{
+    Key key = makeKey(KEY_INIT, 0);
+
+    if (mWorkers.empty())
+    {
+        submit(key, name, std::move(init), [this, done](UMI_ERROR result)
+        {
+            mInitFailed = (UMI_ERROR_NONE != result);
+            if (done)
+            {
+                done(result);
+            }
+        });
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mInitializing = true;
+    }
+
+    submit(key, name, std::move(init), std::move(done));
+}
+
+void HalExecutor::drain()
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    mIdle.wait(lock, [this]() { return 0 == mPending; });
+}
+
+void HalExecutor::run()
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+
+    while (true)
+    {
+        mWorkAvailable.wait(lock, [this]() { return mStopping || !mReady.empty(); });
+
+        if (mReady.empty())
+        {
+            // Stopping and nothing left to run
+            break;
+        }
+
+        Key key = mReady.front();
+        mReady.pop_front();
+
+        Strand& strand = mStrands[key];
+        Job job = std::move(strand.jobs.front());
+        strand.jobs.pop_front();
+        strand.busy = true;
+
+        bool initFailed = mInitFailed;
+
+        lock.unlock();
+
+        UMI_ERROR result = initFailed ? UMI_ERROR_FAIL : runJob(job);
+
+        if (job.done)
+        {
+            g_idle_add_full(G_PRIORITY_DEFAULT, &HalExecutor::onCompleted,
+                            new CompletionEvent{std::move(job.done), result},
+                            &HalExecutor::freeCompletion);
+        }
+
+        lock.lock();
+
+        if (makeKey(KEY_INIT, 0) == key)
+        {
+            // Release the calls that waited for the HAL
+            mInitializing = false;
+            mInitFailed = (UMI_ERROR_NONE != result);
+            mReady.insert(mReady.end(), mHeld.begin(), mHeld.end());
+            mHeld.clear();
+            mWorkAvailable.notify_all();
+        }
+
+        strand.busy = false;
+        if (!strand.jobs.empty())
+        {
+            (mInitializing ? mHeld : mReady).push_back(key);
+            mWorkAvailable.notify_one();
+        }
+
+        if (0 == --mPending)
+        {
+            mIdle.notify_all();
+        }
+    }
+}
+
+UMI_ERROR HalExecutor::runJob(Job& job)
+{
+    auto start = std::chrono::steady_clock::now();
+    UMI_ERROR result = job.call();
+
+    job.stats->record(std::chrono::steady_clock::now() - start, UMI_ERROR_NONE != result);
+    return result;
+}
+
+gboolean HalExecutor::onCompleted(gpointer data)
+{
+    CompletionEvent* event = static_cast<CompletionEvent*>(data);
+    event->done(event->result);
+    return G_SOURCE_REMOVE;
+}
+
+void HalExecutor::freeCompletion(gpointer data)
+{
+    delete static_cast<CompletionEvent*>(data);
+}
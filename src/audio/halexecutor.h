@@ -0,0 +1,154 @@
+// Copyright (c) 2018 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+/**
+ * @file halexecutor.h
+ *
+ * @brief Runs umiClient calls on worker threads, off the GLib main loop
+ *
+ */
+#ifndef HAL_EXECUTOR_H
+#define HAL_EXECUTOR_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <glib.h>
+#include <umiclient.h>
+#include "stats.h"
+
+/**
+ * Queue of HAL calls served by a pool of worker threads.
+ * Every call is tagged with the key of the HAL resource it touches: calls
+ * sharing a key run one at a time in submission order, calls on different
+ * keys may run concurrently. Completions are dispatched on the default
+ * GLib main context, in submission order for a given key. The duration of
+ * every call is recorded in Stats under the name it was submitted with.
+ */
+class HalExecutor
+{
+public:
+    typedef uint64_t Key;
+
+    /**
+     * A blocking HAL call, run on a worker thread.
+     * It must not touch state owned by the main loop.
+     */
+    using Call = std::function<UMI_ERROR()>;
+
+    /**
+     * Runs on the main loop with the result of the call.
+     */
+    using Completion = std::function<void(UMI_ERROR result)>;
+
+    /**
+     * @param workers number of worker threads, 0 runs every call and its
+     *        completion synchronously from submit().
+     */
+    explicit HalExecutor(unsigned int workers);
+    ~HalExecutor();
+
+    HalExecutor(const HalExecutor &) = delete;
+    HalExecutor &operator=(const HalExecutor &) = delete;
+
+    static Key resourceKey(UMI_AUDIO_RESOURCE_T resource)
+    {
+        return makeKey(KEY_RESOURCE, resource);
+    }
+
+    static Key outputKey(UMI_AUDIO_SNDOUT_T output)
+    {
+        return makeKey(KEY_OUTPUT, output);
+    }
+
+    static Key routingKey()
+    {
+        return makeKey(KEY_ROUTING, 0);
+    }
+
+    void submit(Key key, const char* name, Call call, Completion done);
+
+    /**
+     * Run the HAL initialization on a worker. Calls submitted before it
+     * completes are held and run afterwards, in order; if it fails they
+     * all fail without reaching the HAL. Call once, before any submit().
+     */
+    void initialize(const char* name, Call init, Completion done);
+
+    /**
+     * Block until every submitted call has run.
+     * Completions still pending on the main loop are not dispatched.
+     */
+    void drain();
+
+private:
+    enum KeyDomain
+    {
+        KEY_RESOURCE = 1,
+        KEY_OUTPUT,
+        KEY_ROUTING,
+        KEY_INIT
+    };
+
+    static Key makeKey(KeyDomain domain, int id)
+    {
+        return (static_cast<Key>(domain) << 32) | static_cast<uint32_t>(id);
+    }
+
+    struct Job
+    {
+        Call call;
+        Completion done;
+        LatencyStats* stats;
+    };
+
+    static UMI_ERROR runJob(Job& job);
+
+    struct Strand
+    {
+        std::deque<Job> jobs;
+        bool busy = false;
+    };
+
+    struct CompletionEvent
+    {
+        Completion done;
+        UMI_ERROR result;
+    };
+
+    static gboolean onCompleted(gpointer data);
+    static void freeCompletion(gpointer data);
+
+    void run();
+
+    std::mutex mMutex;
+    std::condition_variable mWorkAvailable;
+    std::condition_variable mIdle;
+    std::unordered_map<Key, Strand> mStrands;
+    std::deque<Key> mReady;   // strands with queued jobs and no worker on them
+    std::deque<Key> mHeld;    // same, waiting for the initialization
+    unsigned int mPending = 0;
+    bool mInitializing = false;
+    bool mInitFailed = false;
+    bool mStopping = false;
+    std::vector<std::thread> mWorkers;
+};
+#endif
@@ -16,38 +16,112 @@
 
 #include <cassert>
 #include "ivolumecontroller.h"
+#include "logging.h"
 
-bool IVolumeController::setVolume(SpeakerVolume newVolume)
+void IVolumeController::setVolume(SpeakerVolume newVolume, Completion done)
 {
-    if (newVolume <= MAX_VOLUME && newVolume >= MIN_VOLUME)
+    if (newVolume > MAX_VOLUME || newVolume < MIN_VOLUME)
     {
-        SpeakerVolume oldVolume = mVolume;
-        mVolume = newVolume;
-        bool success = onVolumeChanged();
-        if (!success)
+        if (done)
+            done(false);
+        return;
+    }
+
+    mVolumeRequests++;
+
+    // The HAL has the level already and no write in flight can change that,
+    // several steps of a curve may share one level
+    if (0 == mVolumeWrites && mHalVolumeKnown && toHalLevel(mHalVolume) == toHalLevel(newVolume))
+    {
+        LOG_DEBUG("Volume %d already at HAL level %d, skipping the HAL write",
+                  newVolume, toHalLevel(newVolume));
+        mHalVolume = newVolume;
+        if (!mVolumeKnown || mVolume != newVolume)
         {
-            mVolume = oldVolume;
+            mVolume = newVolume;
+            mVolumeKnown = true;
+            notifyChanged();
         }
-        return success;
+        if (done)
+            done(true);
+        return;
     }
-    else
-        return false;
+
+    SpeakerVolume oldVolume = mVolume;
+    bool changed = !mVolumeKnown || mVolume != newVolume;
+
+    mVolume = newVolume;
+    mVolumeKnown = true;
+    if (changed)
+        notifyChanged();
+
+    writeVolume(newVolume, [this, oldVolume, newVolume, done](bool success)
+    {
+        // Keep a volume requested meanwhile
+        if (!success && mVolume == newVolume)
+        {
+            mVolume = oldVolume;
+            notifyChanged();
+        }
+        if (done)
+            done(success);
+    });
 };
 
-bool IVolumeController::setMute(bool muteFlag)
+void IVolumeController::setMute(bool muteFlag, Completion done)
 {
-    if (muteFlag == mMuted)
+    if (0 == mMuteWrites && mHalMuteKnown && mHalMuted == muteFlag && mMuted == muteFlag)
     {
-        return true;
+        if (done)
+            done(true);
+        return;
     }
 
     bool oldMute = mMuted;
+    bool changed = mMuted != muteFlag;
+
     mMuted = muteFlag;
-    bool success = onMuteChanged();
+    if (changed)
+        notifyChanged();
 
-    if (!success)
+    writeMute(muteFlag, [this, oldMute, muteFlag, done](bool success)
     {
-        mMuted = oldMute;
-    }
-    return success;
+        if (!success && mMuted == muteFlag)
+        {
+            mMuted = oldMute;
+            notifyChanged();
+        }
+        if (done)
+            done(success);
+    });
 };
+
+void IVolumeController::writeVolume(SpeakerVolume volume, Completion done)
+{
+    mVolumeWrites++;
+    mExecutor.submit(mHalKey, "applyVolume",
+                     [this, volume]() { return toError(applyVolume(volume)); },
+                     [this, volume, done](UMI_ERROR result)
+                     {
+                         mVolumeWrites--;
+                         mHalVolume = volume;
+                         mHalVolumeKnown = (UMI_ERROR_NONE == result);
+                         if (done)
+                             done(UMI_ERROR_NONE == result);
+                     });
+}
+
+void IVolumeController::writeMute(bool muted, Completion done)
+{
+    mMuteWrites++;
+    mExecutor.submit(mHalKey, "applyMute",
+                     [this, muted]() { return toError(applyMute(muted)); },
+                     [this, muted, done](UMI_ERROR result)
+                     {
+                         mMuteWrites--;
+                         mHalMuted = muted;
+                         mHalMuteKnown = (UMI_ERROR_NONE == result);
+                         if (done)
+                             done(UMI_ERROR_NONE == result);
+                     });
+}
@@ -23,25 +23,95 @@
 #ifndef IVOLUME_CONTROLLER_H
 #define IVOLUME_CONTROLLER_H
 
+#include <functional>
+#include <memory>
 #include  <umiclient.h>
+#include "halexecutor.h"
+#include "volumecurve.h"
 
 /**
  * Abstract base class for volume control implementations.
  * Subclass this for different speaker types like ext speaker,bluetooth etc
+ *
+ * Changes are applied on the HAL executor. getVolume()/getMute() report the
+ * last requested value right away; it is rolled back if the HAL call fails.
+ * A shadow of the state the HAL last acknowledged skips writes that would
+ * not change anything.
  */
 class IVolumeController
 {
 public:
+    /**
+     * Called on the main loop once the HAL applied the change or failed to.
+     */
+    using Completion = std::function<void(bool success)>;
 
-    IVolumeController() : mVolume(0), mMuted(false) {};
+    IVolumeController(HalExecutor& executor, HalExecutor::Key halKey)
+            : mExecutor(executor), mHalKey(halKey), mVolume(0), mMuted(false), mVolumeKnown(false), mVolumeRequests(0)
+            , mHalVolume(0), mHalMuted(false), mHalVolumeKnown(false), mHalMuteKnown(false)
+            , mVolumeWrites(0), mMuteWrites(0), mCurve(nullptr) {};
     virtual ~IVolumeController() {};
 
+    /**
+     * Called on the main loop whenever getVolume() or getMute() changes.
+     */
+    void setChangeHandler(std::function<void()> handler)
+    {
+        mChangeHandler = handler;
+    }
+
+    /**
+     * Curve mapping volume steps to the levels written to the HAL, the
+     * steps are written as they are without one. Set before init(), the
+     * curve must outlive the controller.
+     */
+    void setCurve(const VolumeCurve* curve)
+    {
+        mCurve = curve;
+    }
+
     void init(bool muted, SpeakerVolume volume)
     {
         mMuted = muted;
         mVolume = volume;
-        onVolumeChanged();
-        onMuteChanged();
+        mVolumeKnown = true;
+        notifyChanged();
+        writeVolume(volume, nullptr);
+        writeMute(muted, nullptr);
+    }
+
+    /**
+     * Same as above with a volume only the HAL knows, e.g. its default.
+     * readVolume is called on the executor, once the HAL is initialized;
+     * getVolume() reports the volume once applied, unless set meanwhile.
+     */
+    void init(bool muted, std::function<SpeakerVolume()> readVolume)
+    {
+        auto volume = std::make_shared<SpeakerVolume>(mVolume);
+        unsigned int requests = mVolumeRequests;
+
+        mMuted = muted;
+        notifyChanged();
+        mVolumeWrites++;
+        mExecutor.submit(mHalKey, "applyVolume",
+                         [this, volume, readVolume]()
+                         {
+                             *volume = readVolume();
+                             return toError(applyVolume(*volume));
+                         },
+                         [this, volume, requests](UMI_ERROR result)
+                         {
+                             mVolumeWrites--;
+                             mHalVolume = *volume;
+                             mHalVolumeKnown = (UMI_ERROR_NONE == result);
+                             if (UMI_ERROR_NONE == result && requests == mVolumeRequests)
+                             {
+                                 mVolume = *volume;
+                                 mVolumeKnown = true;
+                                 notifyChanged();
+                             }
+                         });
+        writeMute(muted, nullptr);
     }
 
     /**
@@ -55,7 +125,7 @@ public:
     /**
      * * Mute/unmute the output.
      */
-    bool setMute(bool muteFlag);
+    void setMute(bool muteFlag, Completion done = nullptr);
 
     /**
      * Get current volume in range 0..100.
@@ -65,30 +135,75 @@ public:
         return mVolume;
     };
 
+    /**
+     * False while the volume is still to be read from the HAL.
+     */
+    inline bool isVolumeKnown() const
+    {
+        return mVolumeKnown;
+    }
+
     /**
      * Set new volume.
      */
-    bool setVolume(SpeakerVolume newVolume);
+    void setVolume(SpeakerVolume newVolume, Completion done = nullptr);
 
 protected:
     /**
-     * Called when volume is changed.
-     * The mVolume field is set to the new volume before calling this.
-     * Performs the appropriate actions to set the new volume.
+     * Called on a HAL worker thread to set a new volume.
+     * Must only talk to the HAL, the controller state belongs to the main loop.
      * @return true on success, false if setting new volume failed.
      */
-    virtual bool onVolumeChanged() = 0;
+    virtual bool applyVolume(SpeakerVolume volume) = 0;
 
     /**
-     * Called when mute is changed.
-     * The mMute field is set to the new value before calling this.
-     * Performs the appropriate actions to set mute.
-     * @return true on success, false if setting new volume failed.
+     * Called on a HAL worker thread to mute or unmute.
+     * Must only talk to the HAL, the controller state belongs to the main loop.
+     * @return true on success, false if setting mute failed.
      */
-    virtual bool onMuteChanged() = 0;
+    virtual bool applyMute(bool muted) = 0;
+
+    /**
+     * HAL level of a volume step, for applyVolume().
+     */
+    SpeakerVolume toHalLevel(SpeakerVolume volume) const
+    {
+        return mCurve ? mCurve->getHalLevel(volume) : volume;
+    }
+
+private:
+    // Submit a HAL write and track its result in the shadow state
+    void writeVolume(SpeakerVolume volume, Completion done);
+    void writeMute(bool muted, Completion done);
+
+    void notifyChanged()
+    {
+        if (mChangeHandler)
+            mChangeHandler();
+    }
+
+    static UMI_ERROR toError(bool success)
+    {
+        return success ? UMI_ERROR_NONE : UMI_ERROR_FAIL;
+    }
 
 private: // Data members
+    HalExecutor& mExecutor;
+    HalExecutor::Key mHalKey;
     SpeakerVolume mVolume;
     bool mMuted;
+    bool mVolumeKnown;
+    unsigned int mVolumeRequests;   // setVolume() calls so far
+
+    // State the HAL acknowledged last, unknown until written or after a failure
+    SpeakerVolume mHalVolume;
+    bool mHalMuted;
+    bool mHalVolumeKnown;
+    bool mHalMuteKnown;
+    unsigned int mVolumeWrites;     // HAL writes in flight
+    unsigned int mMuteWrites;
+    // Read on HAL worker threads, set once before any write
+    const VolumeCurve* mCurve;
+    std::function<void()> mChangeHandler;
 };
 #endif
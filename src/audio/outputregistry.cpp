@@ -0,0 +1,179 @@
+// Copyright (c) 2018 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+
+#include <algorithm>
+#include <glib.h>
+
+#include "outputregistry.h"
+#include "amixercontroller.h"
+#include "logging.h"
+#include "utils.h"
+
+namespace {
+
+// Native rates the configuration may give
+const int32_t minRate = 8000;
+const int32_t maxRate = 192000;
+
+typedef std::unique_ptr<IVolumeController> (*ControllerFactory)(umiClient* umiInstance, HalExecutor& executor,
+                                                                UMI_AUDIO_SNDOUT_T output);
+
+std::unique_ptr<IVolumeController> createAmixer(umiClient* umiInstance, HalExecutor& executor,
+                                                UMI_AUDIO_SNDOUT_T output)
+{
+    return std::unique_ptr<IVolumeController>(new AmixerController(umiInstance, executor, output));
+}
+
+// Controller types the configuration may name. Supporting another kind of
+// speaker is adding its IVolumeController here.
+const struct
+{
+    const char *type;
+    ControllerFactory create;
+} CONTROLLER_TYPES[] = {
+    { "amixer", createAmixer },
+};
+
+ControllerFactory findControllerType(const std::string& type)
+{
+    for (const auto& entry : CONTROLLER_TYPES)
+    {
+        if (type == entry.type)
+            return entry.create;
+    }
+    return nullptr;
+}
+
+} // namespace
+
+OutputRegistry::OutputRegistry(umiClient* umiInstance, HalExecutor& executor,
+                               const std::vector<OutputConfig>& config)
+{
+    std::fill(std::begin(mIndex), std::end(mIndex), AudioRoutes::INVALID_ID);
+
+    // Reserved so that the outputs never move
+    mOutputs.reserve(config.size());
+    mControllers.reserve(config.size());
+
+    for (const OutputConfig& outputConfig : config)
+    {
+        AudioRoutes::Id id = AudioRoutes::getSoundOutId(outputConfig.soundOutput);
+        ControllerFactory create = findControllerType(outputConfig.controller);
+
+        if (id == AudioRoutes::INVALID_ID || !create)
+        {
+            LOG_ERROR(MSGID_CONFIG_VOLUME_ERROR, 0, "Skipping output %s with controller %s",
+                      outputConfig.soundOutput.c_str(), outputConfig.controller.c_str());
+            continue;
+        }
+
+        if (mIndex[id] != AudioRoutes::INVALID_ID)
+        {
+            LOG_ERROR(MSGID_CONFIG_VOLUME_ERROR, 0, "Output %s configured twice",
+                      outputConfig.soundOutput.c_str());
+            continue;
+        }
+
+        mControllers.push_back(create(umiInstance, executor, AudioRoutes::SOUND_OUTS[id].resource));
+        mIndex[id] = static_cast<AudioRoutes::Id>(mOutputs.size());
+        mOutputs.emplace_back(id, AudioRoutes::SOUND_OUTS[id].name, mControllers.back().get(), outputConfig.curve,
+                              outputConfig.rate);
+        mControllers.back()->setCurve(&mOutputs.back().curve);
+
+        LOG_DEBUG("Output %s driven by %s at %u Hz", outputConfig.soundOutput.c_str(),
+                  outputConfig.controller.c_str(), outputConfig.rate);
+    }
+}
+
+std::vector<OutputConfig> OutputRegistry::loadConfig(const std::string& path)
+{
+    gchar* contents = nullptr;
+    pbnjson::JValue configObj;
+    int parseError = 0;
+
+    if (!g_file_get_contents(path.c_str(), &contents, nullptr, nullptr))
+    {
+        LOG_DEBUG("No output configuration in %s, using the defaults", path.c_str());
+        return getDefaultConfig();
+    }
+
+    bool parsed = LSUtils::parsePayload(contents, configObj,
+            STRICT_SCHEMA(PROPS_1(OBJARRAY(outputs,
+                                           OBJSCHEMA_4(PROP(soundOutput, string), PROP(controller, string),
+                                                       OBJECT(curve, OBJSCHEMA_4(PROP(type, string),
+                                                                                 PROP(minDb, number),
+                                                                                 PROP(maxDb, number),
+                                                                                 OBJARRAY(points,
+                                                                                          OBJSCHEMA_2(PROP(step, integer),
+                                                                                                      PROP(db, number))))),
+                                                       PROP(rate, integer))))
+                          REQUIRED_1(outputs)), &parseError);
+    g_free(contents);
+
+    if (!parsed)
+    {
+        LOG_ERROR(MSGID_CONFIG_VOLUME_ERROR, 0, "Invalid output configuration in %s, using the defaults",
+                  path.c_str());
+        return getDefaultConfig();
+    }
+
+    std::vector<OutputConfig> config;
+    pbnjson::JValue outputs = configObj["outputs"];
+
+    for (ssize_t i = 0; i < outputs.arraySize(); i++)
+    {
+        OutputConfig output{outputs[i]["soundOutput"].asString(), outputs[i]["controller"].asString(),
+                            VolumeCurveConfig(), DEFAULT_RATE};
+
+        if (outputs[i].hasKey("curve") && !VolumeCurveConfig::parse(outputs[i]["curve"], output.curve))
+        {
+            LOG_ERROR(MSGID_CONFIG_VOLUME_ERROR, 0, "Invalid volume curve of output %s, using a linear one",
+                      output.soundOutput.c_str());
+            output.curve = VolumeCurveConfig();
+        }
+
+        if (outputs[i].hasKey("rate"))
+        {
+            int32_t rate = outputs[i]["rate"].asNumber<int32_t>();
+            if (rate >= minRate && rate <= maxRate)
+            {
+                output.rate = static_cast<unsigned int>(rate);
+            }
+            else
+            {
+                LOG_ERROR(MSGID_CONFIG_VOLUME_ERROR, 0, "Invalid rate %d of output %s, using %u Hz",
+                          rate, output.soundOutput.c_str(), DEFAULT_RATE);
+            }
+        }
+
+        config.push_back(output);
+    }
+
+    return config;
+}
+
+std::vector<OutputConfig> OutputRegistry::getDefaultConfig()
+{
+    std::vector<OutputConfig> config;
+
+    for (const auto& soundOut : AudioRoutes::SOUND_OUTS)
+    {
+        config.push_back({soundOut.name, "amixer", VolumeCurveConfig(), DEFAULT_RATE});
+    }
+
+    return config;
+}
@@ -0,0 +1,128 @@
+// Copyright (c) 2018 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+
+/**
+ * @file outputregistry.h
+ *
+ * @brief Sound outputs and the volume controllers driving them
+ *
+ */
+#ifndef OUTPUT_REGISTRY_H
+#define OUTPUT_REGISTRY_H
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <umiclient.h>
+
+#include "audioroutes.h"
+#include "halexecutor.h"
+#include "ivolumecontroller.h"
+#include "volumecurve.h"
+#include "dsp/equalizer.h"
+
+struct AudioOutput
+{
+    AudioOutput(AudioRoutes::Id _id, const std::string& _name, IVolumeController* _volumeController,
+                const VolumeCurveConfig& curveConfig, unsigned int _rate)
+            : id(_id)
+            , name(_name)
+            , userMute(true)
+            , volumeController(_volumeController)
+            , curve(curveConfig)
+            , rate(_rate)
+    {};
+
+    AudioRoutes::Id id;
+    std::string name;
+    bool userMute;
+    IVolumeController* volumeController;
+    VolumeCurve curve;
+    // Applied by the software mixer while its mix is routed here
+    Equalizer equalizer;
+    // Native sample rate, the software mix is resampled to it
+    unsigned int rate;
+};
+
+/**
+ * Output to create at startup: a soundOut of AudioRoutes::SOUND_OUTS and
+ * the type of controller driving it.
+ */
+struct OutputConfig
+{
+    std::string soundOutput;
+    std::string controller;
+    VolumeCurveConfig curve;
+    unsigned int rate;
+};
+
+/**
+ * Owns the configured outputs and their controllers. Outputs are kept in
+ * one array, in configuration order, and found by soundOut id through an
+ * index table; they are never added or removed after construction so
+ * references to them stay valid.
+ */
+class OutputRegistry final
+{
+public:
+    /**
+     * Outputs with an unknown soundOut or controller type, or configured
+     * twice, are skipped with an error.
+     */
+    OutputRegistry(umiClient* umiInstance, HalExecutor& executor, const std::vector<OutputConfig>& config);
+
+    // Native rate of outputs whose configuration does not give one
+    static const unsigned int DEFAULT_RATE = 48000;
+
+    OutputRegistry(const OutputRegistry &) = delete;
+    OutputRegistry &operator=(const OutputRegistry &) = delete;
+
+    /**
+     * Reads {"outputs": [{"soundOutput": ..., "controller": ..., "curve": ..., "rate": ...}, ...]}
+     * from path, getDefaultConfig() if the file is missing or invalid.
+     * An invalid curve, see VolumeCurveConfig::parse(), is replaced by a
+     * linear one, and a rate out of 8 to 192 kHz by DEFAULT_RATE.
+     */
+    static std::vector<OutputConfig> loadConfig(const std::string& path);
+
+    // Every soundOut of AudioRoutes::SOUND_OUTS driven by the amixer controller
+    static std::vector<OutputConfig> getDefaultConfig();
+
+    AudioOutput* find(AudioRoutes::Id id)
+    {
+        return (id < OUTPUT_INDEX_SIZE && mIndex[id] != AudioRoutes::INVALID_ID) ? &mOutputs[mIndex[id]] : nullptr;
+    }
+
+    AudioOutput* find(const std::string& name)
+    {
+        return find(AudioRoutes::getSoundOutId(name));
+    }
+
+    std::vector<AudioOutput>::iterator begin() { return mOutputs.begin(); }
+    std::vector<AudioOutput>::iterator end() { return mOutputs.end(); }
+    size_t size() const { return mOutputs.size(); }
+
+private:
+    static const size_t OUTPUT_INDEX_SIZE = sizeof(AudioRoutes::SOUND_OUTS) / sizeof(AudioRoutes::SOUND_OUTS[0]);
+
+    std::vector<std::unique_ptr<IVolumeController>> mControllers;
+    std::vector<AudioOutput> mOutputs;
+
+    // Position in mOutputs of each soundOut id, INVALID_ID if not configured
+    AudioRoutes::Id mIndex[OUTPUT_INDEX_SIZE];
+};
+#endif
@@ -0,0 +1,80 @@
+// Copyright (c) 2018 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+
+#include "logging.h"
+#include "transaction.h"
+
+std::shared_ptr<Transaction> Transaction::create()
+{
+    return std::shared_ptr<Transaction>(new Transaction());
+}
+
+void Transaction::add(Action apply, Action undo)
+{
+    mSteps.push_back(Step{std::move(apply), std::move(undo)});
+}
+
+void Transaction::run(Completion done)
+{
+    mDone = std::move(done);
+    applyStep(0);
+}
+
+void Transaction::applyStep(size_t index)
+{
+    if (index == mSteps.size())
+    {
+        mDone(-1);
+        return;
+    }
+
+    // Keeps the transaction alive until the step completes
+    auto self = shared_from_this();
+
+    mSteps[index].apply([self, index](bool success)
+    {
+        if (success)
+            self->applyStep(index + 1);
+        else
+            self->undoStep(index, static_cast<int>(index));
+    });
+}
+
+void Transaction::undoStep(size_t count, int failedStep)
+{
+    if (0 == count)
+    {
+        mDone(failedStep);
+        return;
+    }
+
+    size_t index = count - 1;
+    auto self = shared_from_this();
+
+    if (!mSteps[index].undo)
+    {
+        undoStep(index, failedStep);
+        return;
+    }
+
+    mSteps[index].undo([self, index, failedStep](bool success)
+    {
+        if (!success)
+            LOG_ERROR(MSGID_HAL_ERROR, 0, "Failed to roll back step %zu of a transaction", index);
+        self->undoStep(index, failedStep);
+    });
+}
@@ -0,0 +1,75 @@
+// Copyright (c) 2018 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+
+/**
+ * @file transaction.h
+ *
+ * @brief Ordered asynchronous steps, undone in reverse order when one fails
+ *
+ */
+#ifndef TRANSACTION_H
+#define TRANSACTION_H
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+/**
+ * Runs its steps one after the other, each starting once the previous one
+ * reported success. When a step fails, the steps applied before it are
+ * undone, last first, and the transaction completes with the index of the
+ * failed step. Undo failures are not reported, there is nothing left to
+ * roll back to.
+ */
+class Transaction : public std::enable_shared_from_this<Transaction>
+{
+public:
+    using Done = std::function<void(bool success)>;
+    using Action = std::function<void(Done done)>;
+
+    // failedStep is -1 when all the steps succeeded
+    using Completion = std::function<void(int failedStep)>;
+
+    static std::shared_ptr<Transaction> create();
+
+    Transaction(const Transaction &) = delete;
+    Transaction &operator=(const Transaction &) = delete;
+
+    // undo may be empty for steps that can not be rolled back
+    void add(Action apply, Action undo);
+
+    size_t size() const { return mSteps.size(); }
+
+    void run(Completion done);
+
+private:
+    Transaction() = default;
+
+    struct Step
+    {
+        Action apply;
+        Action undo;
+    };
+
+    void applyStep(size_t index);
+    void undoStep(size_t count, int failedStep);
+
+    std::vector<Step> mSteps;
+    Completion mDone;
+};
+
+#endif
@@ -0,0 +1,158 @@
+// Copyright (c) 2018 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include <utility>
+#include "logging.h"
+#include "volumecoalescer.h"
+#include "volumeservice.h"
+
+VolumeCoalescer::VolumeCoalescer(unsigned int windowMs, WriteHandler handler)
+        : mWindowMs(windowMs)
+        , mHandler(handler)
+{}
+
+VolumeCoalescer::~VolumeCoalescer()
+{
+    for (auto& iter : mPending)
+    {
+        g_source_remove(iter.second.timerId);
+    }
+}
+
+SpeakerVolume VolumeCoalescer::getTargetVolume(const AudioOutput& output) const
+{
+    auto iter = mPending.find(&output);
+    if (iter != mPending.end())
+    {
+        return iter->second.volume;
+    }
+
+    return output.volumeController->getVolume();
+}
+
+void VolumeCoalescer::setVolume(AudioOutput& output, SpeakerVolume volume,
+                                IVolumeController::Completion done)
+{
+    std::vector<IVolumeController::Completion> dones;
+    if (done)
+    {
+        dones.push_back(std::move(done));
+    }
+
+    if (0 == mWindowMs)
+    {
+        write(output, volume, std::move(dones));
+        return;
+    }
+
+    auto iter = mPending.find(&output);
+    if (iter != mPending.end())
+    {
+        iter->second.volume = volume;
+        iter->second.dones.insert(iter->second.dones.end(), dones.begin(), dones.end());
+        return;
+    }
+
+    PendingWrite& pending = mPending[&output];
+    pending.dones = std::move(dones);
+    pending.owner = this;
+    pending.output = &output;
+    pending.volume = volume;
+    pending.timerId = g_timeout_add(mWindowMs, &VolumeCoalescer::onWindowElapsed, &pending);
+}
+
+void VolumeCoalescer::cancel(AudioOutput& output)
+{
+    auto iter = mPending.find(&output);
+    if (iter == mPending.end())
+    {
+        return;
+    }
+
+    std::vector<IVolumeController::Completion> dones = std::move(iter->second.dones);
+
+    g_source_remove(iter->second.timerId);
+    mPending.erase(iter);
+
+    for (auto& done : dones)
+    {
+        done(true);
+    }
+}
+
+void VolumeCoalescer::flush()
+{
+    auto pending = std::move(mPending);
+    mPending.clear();
+
+    for (auto& iter : pending)
+    {
+        g_source_remove(iter.second.timerId);
+        write(*iter.second.output, iter.second.volume, std::move(iter.second.dones));
+    }
+}
+
+gboolean VolumeCoalescer::onWindowElapsed(gpointer data)
+{
+    PendingWrite* pending = static_cast<PendingWrite*>(data);
+    VolumeCoalescer* self = pending->owner;
+    AudioOutput& output = *pending->output;
+    SpeakerVolume volume = pending->volume;
+    std::vector<IVolumeController::Completion> dones = std::move(pending->dones);
+
+    self->mPending.erase(&output);
+
+    self->write(output, volume, std::move(dones));
+
+    return G_SOURCE_REMOVE;
+}
+
+void VolumeCoalescer::write(AudioOutput& output, SpeakerVolume volume,
+                            std::vector<IVolumeController::Completion> dones)
+{
+    // Changes that cancelled each other out need no HAL write at all
+    if (mWindowMs && volume == output.volumeController->getVolume())
+    {
+        for (auto& done : dones)
+        {
+            done(true);
+        }
+        return;
+    }
+
+    output.volumeController->setVolume(volume, [this, &output, volume, dones](bool success)
+    {
+        if (!success)
+        {
+            LOG_ERROR(MSGID_CONFIG_VOLUME_ERROR, 0, "Failed to apply coalesced volume %d on %s",
+                      volume, output.name.c_str());
+        }
+        else
+        {
+            LOG_DEBUG("Coalesced volume %d applied on %s", volume, output.name.c_str());
+        }
+
+        if (mHandler)
+        {
+            mHandler(output, success);
+        }
+
+        for (auto& done : dones)
+        {
+            done(success);
+        }
+    });
+}
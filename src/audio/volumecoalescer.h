@@ -0,0 +1,97 @@
+// Copyright (c) 2018 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+/**
+ * @file volumecoalescer.h
+ *
+ * @brief Merges bursts of volume changes on an output into one HAL write
+ *
+ */
+#ifndef VOLUME_COALESCER_H
+#define VOLUME_COALESCER_H
+
+#include <functional>
+#include <unordered_map>
+#include <vector>
+#include <glib.h>
+#include <umiclient.h>
+#include "ivolumecontroller.h"
+
+struct AudioOutput;
+
+/**
+ * Holds back volume writes of an output for a short window.
+ * The first change on an idle output arms a timer, changes arriving before
+ * it fires only update the pending target, and the timer writes the final
+ * value to the volume controller. Every change merged into a write is
+ * completed with its result. A window of 0 passes every change on.
+ */
+class VolumeCoalescer
+{
+public:
+    /**
+     * Called once per write the controller completed, before the
+     * completions of the changes merged into it.
+     */
+    using WriteHandler = std::function<void(AudioOutput& output, bool success)>;
+
+    VolumeCoalescer(unsigned int windowMs, WriteHandler handler);
+    ~VolumeCoalescer();
+
+    VolumeCoalescer(const VolumeCoalescer &) = delete;
+    VolumeCoalescer &operator=(const VolumeCoalescer &) = delete;
+
+    /**
+     * Volume the output has once pending writes are done.
+     */
+    SpeakerVolume getTargetVolume(const AudioOutput& output) const;
+
+    /**
+     * Request a new volume, done gets the result of the write it is
+     * merged into.
+     */
+    void setVolume(AudioOutput& output, SpeakerVolume volume, IVolumeController::Completion done);
+
+    /**
+     * Drop the pending write of the output, if any. Its changes were
+     * replaced by a later request and complete successfully.
+     */
+    void cancel(AudioOutput& output);
+
+    /**
+     * Write every pending volume now.
+     */
+    void flush();
+
+private:
+    struct PendingWrite
+    {
+        VolumeCoalescer* owner;
+        AudioOutput* output;
+        SpeakerVolume volume;
+        guint timerId;
+        std::vector<IVolumeController::Completion> dones;
+    };
+
+    static gboolean onWindowElapsed(gpointer data);
+
+    void write(AudioOutput& output, SpeakerVolume volume, std::vector<IVolumeController::Completion> dones);
+
+    unsigned int mWindowMs;
+    WriteHandler mHandler;
+    std::unordered_map<const AudioOutput*, PendingWrite> mPending;
+};
+#endif
@@ -0,0 +1,146 @@
+// Copyright (c) 2018 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+
+#include <algorithm>
+#include <cmath>
+#include "volumecurve.h"
+
+constexpr float VolumeCurve::SILENCE_DB;
+
+bool VolumeCurveConfig::parse(const pbnjson::JValue& curveObj, VolumeCurveConfig& config)
+{
+    std::string type = curveObj["type"].asString();
+
+    if ("linear" == type)
+    {
+        config.type = VolumeCurveType::LINEAR;
+        return true;
+    }
+
+    if ("log" == type)
+    {
+        config.type = VolumeCurveType::LOG;
+        if (curveObj.hasKey("minDb"))
+            config.minDb = curveObj["minDb"].asNumber<double>();
+        if (curveObj.hasKey("maxDb"))
+            config.maxDb = curveObj["maxDb"].asNumber<double>();
+        return config.minDb < config.maxDb && config.maxDb <= 0.0f;
+    }
+
+    if ("custom" != type || !curveObj["points"].isArray() || curveObj["points"].arraySize() < 2)
+        return false;
+
+    pbnjson::JValue points = curveObj["points"];
+
+    config.type = VolumeCurveType::CUSTOM;
+    config.points.clear();
+    for (ssize_t i = 0; i < points.arraySize(); i++)
+    {
+        int step = points[i]["step"].asNumber<int>();
+        float db = points[i]["db"].asNumber<double>();
+
+        if (step < MIN_VOLUME || step > MAX_VOLUME || db > 0.0f ||
+            (!config.points.empty() && step <= config.points.back().step))
+            return false;
+
+        config.points.push_back({step, db});
+    }
+
+    return true;
+}
+
+VolumeCurve::VolumeCurve(const VolumeCurveConfig& config)
+        : mType(config.type)
+{
+    for (int i = 0; i < STEPS; i++)
+    {
+        SpeakerVolume step = MIN_VOLUME + i;
+        Step& entry = mSteps[i];
+
+        if (MIN_VOLUME == step)
+        {
+            entry = Step{SILENCE_DB, 0.0f, MIN_VOLUME};
+            continue;
+        }
+
+        switch (mType)
+        {
+            case VolumeCurveType::LINEAR:
+                entry.gain = static_cast<float>(step - MIN_VOLUME) / (MAX_VOLUME - MIN_VOLUME);
+                entry.db = 20.0f * log10f(entry.gain);
+                break;
+
+            case VolumeCurveType::LOG:
+                entry.db = config.minDb + (config.maxDb - config.minDb) * (step - MIN_VOLUME - 1) /
+                                          (MAX_VOLUME - MIN_VOLUME - 1);
+                entry.gain = powf(10.0f, entry.db / 20.0f);
+                break;
+
+            case VolumeCurveType::CUSTOM:
+                entry.db = interpolate(config.points, step);
+                entry.gain = powf(10.0f, entry.db / 20.0f);
+                break;
+        }
+
+        // LINEAR keeps the steps the HAL has always been given, and no
+        // step above MIN_VOLUME is silent
+        long level = lrintf(entry.gain * (MAX_VOLUME - MIN_VOLUME));
+        entry.halLevel = (VolumeCurveType::LINEAR == mType) ? step
+                                                            : static_cast<SpeakerVolume>(MIN_VOLUME + std::max(1L, level));
+    }
+}
+
+SpeakerVolume VolumeCurve::getStep(SpeakerVolume halLevel) const
+{
+    // HAL levels never decrease with the step
+    const Step* found = std::lower_bound(std::begin(mSteps), std::end(mSteps), halLevel,
+                                         [](const Step& entry, SpeakerVolume level) { return entry.halLevel < level; });
+
+    return (found == std::end(mSteps)) ? MAX_VOLUME : MIN_VOLUME + static_cast<SpeakerVolume>(found - mSteps);
+}
+
+const char* VolumeCurve::getTypeName() const
+{
+    switch (mType)
+    {
+        case VolumeCurveType::LOG:
+            return "log";
+        case VolumeCurveType::CUSTOM:
+            return "custom";
+        default:
+            return "linear";
+    }
+}
+
+float VolumeCurve::interpolate(const std::vector<VolumeCurveConfig::Point>& points, SpeakerVolume step)
+{
+    if (step <= points.front().step)
+        return points.front().db;
+
+    for (size_t i = 1; i < points.size(); i++)
+    {
+        if (step <= points[i].step)
+        {
+            const VolumeCurveConfig::Point& low = points[i - 1];
+            const VolumeCurveConfig::Point& high = points[i];
+
+            return low.db + (high.db - low.db) * (step - low.step) / (high.step - low.step);
+        }
+    }
+
+    return points.back().db;
+}
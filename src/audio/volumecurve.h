@@ -0,0 +1,129 @@
+// Copyright (c) 2018 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+
+/**
+ * @file volumecurve.h
+ *
+ * @brief Perceptual mapping of volume steps to attenuation and HAL levels
+ *
+ */
+#ifndef VOLUME_CURVE_H
+#define VOLUME_CURVE_H
+
+#include <vector>
+#include <pbnjson.hpp>
+#include <umiclient.h>
+
+enum class VolumeCurveType
+{
+    LINEAR,     // steps passed to the HAL as they are
+    LOG,        // steps evenly spaced in dB between minDb and maxDb
+    CUSTOM      // dB interpolated between configured breakpoints
+};
+
+/**
+ * Shape of the curve of an output, from the outputs configuration.
+ */
+struct VolumeCurveConfig
+{
+    struct Point
+    {
+        SpeakerVolume step;
+        float db;
+    };
+
+    VolumeCurveType type = VolumeCurveType::LINEAR;
+    // LOG: attenuation of the lowest audible step and of MAX_VOLUME. The
+    // default floor is the lowest level above silence of a 0..100 HAL.
+    float minDb = -40.0f;
+    float maxDb = 0.0f;
+    // CUSTOM: at least two, sorted by step
+    std::vector<Point> points;
+
+    /**
+     * Read {"type": "linear"|"log"|"custom", "minDb": ..., "maxDb": ...,
+     * "points": [{"step": ..., "db": ...}, ...]}, false if it is invalid.
+     */
+    static bool parse(const pbnjson::JValue& curveObj, VolumeCurveConfig& config);
+};
+
+/**
+ * Tables of the attenuation, linear gain and HAL level of every volume
+ * step, computed once so that lookups cost an index. Step MIN_VOLUME is
+ * silence whatever the curve.
+ * The HAL level scale is taken as linear in amplitude, so that a curve
+ * other than LINEAR writes round(gain * MAX_VOLUME), at least 1 for any
+ * audible step; the HAL granularity is unchanged. getGain() serves
+ * software gain stages.
+ */
+class VolumeCurve
+{
+public:
+    // Reported for silence, which has no finite attenuation
+    static constexpr float SILENCE_DB = -120.0f;
+
+    explicit VolumeCurve(const VolumeCurveConfig& config = VolumeCurveConfig());
+
+    float getDb(SpeakerVolume step) const
+    {
+        return mSteps[index(step)].db;
+    }
+
+    float getGain(SpeakerVolume step) const
+    {
+        return mSteps[index(step)].gain;
+    }
+
+    SpeakerVolume getHalLevel(SpeakerVolume step) const
+    {
+        return mSteps[index(step)].halLevel;
+    }
+
+    /**
+     * Lowest step the HAL level is written for, e.g. to read back a HAL
+     * default volume.
+     */
+    SpeakerVolume getStep(SpeakerVolume halLevel) const;
+
+    VolumeCurveType getType() const
+    {
+        return mType;
+    }
+
+    const char* getTypeName() const;
+
+private:
+    static const int STEPS = MAX_VOLUME - MIN_VOLUME + 1;
+
+    struct Step
+    {
+        float db;
+        float gain;
+        SpeakerVolume halLevel;
+    };
+
+    static int index(SpeakerVolume step)
+    {
+        return (step < MIN_VOLUME) ? 0 : (step > MAX_VOLUME) ? STEPS - 1 : step - MIN_VOLUME;
+    }
+
+    static float interpolate(const std::vector<VolumeCurveConfig::Point>& points, SpeakerVolume step);
+
+    VolumeCurveType mType;
+    Step mSteps[STEPS];
+};
+#endif
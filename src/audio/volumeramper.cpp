@@ -0,0 +1,206 @@
+// Copyright (c) 2018 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include <vector>
+#include "logging.h"
+#include "volumeramper.h"
+#include "volumeservice.h"
+
+VolumeRamper::~VolumeRamper()
+{
+    if (mTimerId)
+    {
+        g_source_remove(mTimerId);
+    }
+}
+
+void VolumeRamper::ramp(AudioOutput& output, SpeakerVolume start, SpeakerVolume target, SpeakerVolume reported,
+                        const RampConfig& config, Completion done)
+{
+    gint64 now = g_get_monotonic_time();
+    Ramp& ramp = mRamps[&output];
+
+    // Told once the new ramp is in place, so that isRamping() holds
+    Completion superseded = std::move(ramp.done);
+
+    ramp.output = &output;
+    ramp.start = start;
+    ramp.target = target;
+    ramp.reported = reported;
+    ramp.curve = config.curve;
+    ramp.startTime = now;
+    ramp.durationUs = static_cast<gint64>(config.durationMs) * 1000;
+    ramp.stepPeriodUs = std::max<gint64>(ramp.durationUs / MAX_STEPS, TICK_MS * 1000);
+    ramp.nextStepTime = now;
+    ramp.generation = ++mGeneration;
+    ramp.stepInFlight = false;
+    ramp.done = done;
+
+    if (superseded)
+    {
+        superseded(Result::SUPERSEDED);
+    }
+
+    if (0 == config.durationMs)
+    {
+        finish(output);
+        return;
+    }
+
+    if (!mTimerId)
+    {
+        mTimerId = g_timeout_add(TICK_MS, &VolumeRamper::onTick, this);
+    }
+}
+
+bool VolumeRamper::getTargetVolume(const AudioOutput& output, SpeakerVolume& volume) const
+{
+    auto iter = mRamps.find(&output);
+    if (iter == mRamps.end())
+    {
+        return false;
+    }
+
+    volume = iter->second.reported;
+    return true;
+}
+
+void VolumeRamper::cancel(AudioOutput& output)
+{
+    auto iter = mRamps.find(&output);
+    if (iter == mRamps.end())
+    {
+        return;
+    }
+
+    Completion done = std::move(iter->second.done);
+    mRamps.erase(iter);
+
+    if (done)
+    {
+        done(Result::SUPERSEDED);
+    }
+}
+
+void VolumeRamper::flush()
+{
+    while (!mRamps.empty())
+    {
+        finish(*mRamps.begin()->second.output);
+    }
+}
+
+gboolean VolumeRamper::onTick(gpointer data)
+{
+    VolumeRamper* self = static_cast<VolumeRamper*>(data);
+    gint64 now = g_get_monotonic_time();
+    std::vector<std::pair<AudioOutput*, unsigned int>> finished;
+
+    for (auto& iter : self->mRamps)
+    {
+        Ramp& ramp = iter.second;
+
+        if (now - ramp.startTime >= ramp.durationUs)
+        {
+            finished.emplace_back(ramp.output, ramp.generation);
+        }
+        else if (!ramp.stepInFlight && now >= ramp.nextStepTime)
+        {
+            ramp.nextStepTime = now + ramp.stepPeriodUs;
+            self->step(ramp, levelAt(ramp, now));
+        }
+    }
+
+    // Completions may start new ramps, finish outside of the loop and
+    // leave alone the ones that replaced a ramp finished here
+    for (auto& entry : finished)
+    {
+        auto iter = self->mRamps.find(entry.first);
+        if (iter != self->mRamps.end() && iter->second.generation == entry.second)
+        {
+            self->finish(*entry.first);
+        }
+    }
+
+    if (self->mRamps.empty())
+    {
+        self->mTimerId = 0;
+        return G_SOURCE_REMOVE;
+    }
+
+    return G_SOURCE_CONTINUE;
+}
+
+SpeakerVolume VolumeRamper::levelAt(const Ramp& ramp, gint64 now)
+{
+    double progress = static_cast<double>(now - ramp.startTime) / ramp.durationUs;
+    double shape = (RampCurve::LOG == ramp.curve) ? std::log10(1.0 + 9.0 * progress) : progress;
+
+    return ramp.start + static_cast<int>(std::lround((ramp.target - ramp.start) * shape));
+}
+
+void VolumeRamper::step(Ramp& ramp, SpeakerVolume level)
+{
+    AudioOutput* output = ramp.output;
+    unsigned int generation = ramp.generation;
+
+    if (level == output->volumeController->getVolume())
+    {
+        return;
+    }
+
+    ramp.stepInFlight = true;
+    output->volumeController->setVolume(level, [this, output, generation](bool success)
+    {
+        auto iter = mRamps.find(output);
+        if (iter != mRamps.end() && iter->second.generation == generation)
+        {
+            iter->second.stepInFlight = false;
+        }
+    });
+}
+
+void VolumeRamper::finish(AudioOutput& output)
+{
+    auto iter = mRamps.find(&output);
+    if (iter == mRamps.end())
+    {
+        return;
+    }
+
+    SpeakerVolume target = iter->second.target;
+    Completion done = std::move(iter->second.done);
+
+    mRamps.erase(iter);
+
+    output.volumeController->setVolume(target, [&output, target, done](bool success)
+    {
+        if (!success)
+        {
+            LOG_ERROR(MSGID_CONFIG_VOLUME_ERROR, 0, "Failed to end volume ramp at %d on %s",
+                      target, output.name.c_str());
+        }
+
+        if (done)
+        {
+            done(success ? Result::DONE : Result::FAILED);
+        }
+    });
+}
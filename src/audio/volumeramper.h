@@ -0,0 +1,135 @@
+// Copyright (c) 2018 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+
+/**
+ * @file volumeramper.h
+ *
+ * @brief Fades output volumes in a bounded number of HAL writes
+ *
+ */
+#ifndef VOLUME_RAMPER_H
+#define VOLUME_RAMPER_H
+
+#include <functional>
+#include <unordered_map>
+#include <glib.h>
+#include <umiclient.h>
+#include "ivolumecontroller.h"
+
+struct AudioOutput;
+
+enum class RampCurve
+{
+    LINEAR,
+    LOG         // fast at first, slow towards the target
+};
+
+/**
+ * How to move an output to a new level, durationMs 0 jumps right away.
+ */
+struct RampConfig
+{
+    unsigned int durationMs = 0;
+    RampCurve curve = RampCurve::LINEAR;
+};
+
+/**
+ * Moves the volume of outputs to a target over time.
+ * One main loop timer serves every ramp in progress and is only armed
+ * while there is one. A ramp writes intermediate levels at most
+ * MAX_STEPS times and never queues a step behind one still in flight, so
+ * a slow HAL gets fewer steps rather than a backlog. Starting a ramp on
+ * an output supersedes the ramp in progress, which continues from the
+ * level it reached.
+ */
+class VolumeRamper
+{
+public:
+    enum class Result
+    {
+        DONE,           // target written
+        FAILED,         // writing the target failed
+        SUPERSEDED      // cancelled or replaced by another ramp
+    };
+
+    using Completion = std::function<void(Result result)>;
+
+    static const unsigned int TICK_MS = 10;
+    static const unsigned int MAX_STEPS = 25;
+
+    VolumeRamper() = default;
+    ~VolumeRamper();
+
+    VolumeRamper(const VolumeRamper &) = delete;
+    VolumeRamper &operator=(const VolumeRamper &) = delete;
+
+    /**
+     * Ramp output from start to target. getTargetVolume() reports
+     * reported meanwhile, the level the output is considered to have.
+     */
+    void ramp(AudioOutput& output, SpeakerVolume start, SpeakerVolume target, SpeakerVolume reported,
+              const RampConfig& config, Completion done);
+
+    /**
+     * False if no ramp is in progress on the output.
+     */
+    bool getTargetVolume(const AudioOutput& output, SpeakerVolume& volume) const;
+
+    bool isRamping(const AudioOutput& output) const
+    {
+        return mRamps.count(&output) != 0;
+    }
+
+    /**
+     * Stop the ramp of the output where it is, if any.
+     */
+    void cancel(AudioOutput& output);
+
+    /**
+     * Write the target of every ramp now.
+     */
+    void flush();
+
+private:
+    struct Ramp
+    {
+        AudioOutput* output;
+        SpeakerVolume start;
+        SpeakerVolume target;
+        SpeakerVolume reported;
+        RampCurve curve;
+        gint64 startTime;
+        gint64 durationUs;
+        gint64 stepPeriodUs;
+        gint64 nextStepTime;
+        unsigned int generation;
+        bool stepInFlight;
+        Completion done;
+    };
+
+    static gboolean onTick(gpointer data);
+
+    static SpeakerVolume levelAt(const Ramp& ramp, gint64 now);
+
+    void step(Ramp& ramp, SpeakerVolume level);
+    void finish(AudioOutput& output);
+
+    std::unordered_map<const AudioOutput*, Ramp> mRamps;
+    unsigned int mGeneration = 0;
+    guint mTimerId = 0;
+};
+#endif
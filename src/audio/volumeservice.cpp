@@ -14,23 +14,135 @@
 //
 // SPDX-License-Identifier: Apache-2.0
 
+#include <cmath>
 #include <map>
 #include "volumeservice.h"
 #include  <umiclient.h>
 #include "logging.h"
 
-VolumeService::VolumeService(LS::Handle &handle,umiClient* umiInstance)
+// soundOutput of the set and muteSoundOut methods changing every output
+static const char* const allOutputs = "all";
+
+// Fields of the flat requests, decoded by LSUtils::FieldDecoder
+struct OutputParams
+{
+    std::string soundOutput;
+};
+
+struct SetParams
+{
+    std::string soundOutput;
+    int volume = 0;
+};
+
+struct MuteSoundOutParams
+{
+    std::string soundOutput;
+    bool mute = false;
+};
+
+// Longest fade the set and muteSoundOut methods accept
+static const int maxRampMs = 10000;
+
+#define RAMP_SCHEMA OBJECT(ramp, OBJSCHEMA_2(PROP(duration, integer), PROP_WITH_VAL_2(curve, string, "linear", "log")))
+
+// Read the optional ramp of a request, false if it is out of range
+static bool parseRamp(const pbnjson::JValue& requestObj, RampConfig& ramp)
+{
+    // Null when the request was decoded without a DOM, it had no ramp then
+    if (!requestObj.isObject() || !requestObj.hasKey("ramp"))
+        return true;
+
+    pbnjson::JValue rampObj = requestObj["ramp"];
+    int duration = rampObj["duration"].asNumber<int>();
+
+    if (duration < 0 || duration > maxRampMs)
+        return false;
+
+    ramp.durationMs = duration;
+    ramp.curve = (rampObj["curve"].asString() == "log") ? RampCurve::LOG : RampCurve::LINEAR;
+    return true;
+}
+
+VolumeService::VolumeService(LS::Handle &handle,umiClient* umiInstance, HalExecutor& halExecutor,
+                             StateStore& stateStore, const std::vector<OutputConfig>& outputs,
+                             unsigned int volumeWindowMs)
         : mService(&handle)
-         ,mAmixer(umiInstance)
+         ,mHalExecutor(halExecutor)
+         ,mStateStore(stateStore)
+         ,mOutputs(umiInstance, halExecutor, outputs)
+         ,mOutputsMuted(false)
+         ,mCoalescer(volumeWindowMs, [this](AudioOutput& output, bool success)
+                     {
+                         // Once per write however many up/down it merged,
+                         // on failure too as the target they saw is undone
+                         notifyStatus(output);
+                     })
 {
+    mStatusSubscription.setServiceHandle(mService);
+
     LS_CREATE_CATEGORY_BEGIN(VolumeService, volume)
-    LS_CATEGORY_METHOD(up)
-    LS_CATEGORY_METHOD(down)
-    LS_CATEGORY_METHOD(set)
-    LS_CATEGORY_METHOD(getStatus)
-    LS_CATEGORY_METHOD(muteSoundOut)
+    LS_CATEGORY_TIMED_METHOD(up)
+    LS_CATEGORY_TIMED_METHOD(down)
+    LS_CATEGORY_TIMED_METHOD(set)
+    LS_CATEGORY_TIMED_METHOD(getStatus)
+    LS_CATEGORY_TIMED_METHOD(muteSoundOut)
+    LS_CATEGORY_TIMED_METHOD(setEqualizer)
     LS_CREATE_CATEGORY_END
 
+    mSchemas.add("up", STRICT_SCHEMA(PROPS_1(PROP(soundOutput, string)) REQUIRED_1(soundOutput)));
+    mSchemas.add("down", STRICT_SCHEMA(PROPS_1(PROP(soundOutput, string)) REQUIRED_1(soundOutput)));
+    mSchemas.add("set", STRICT_SCHEMA(PROPS_3(PROP(soundOutput, string), PROP(volume, integer), RAMP_SCHEMA)
+                                      REQUIRED_2(soundOutput, volume)));
+    mSchemas.add("getStatus", STRICT_SCHEMA(PROPS_1(PROP(subscribe, boolean))));
+    mSchemas.add("muteSoundOut", STRICT_SCHEMA(PROPS_3(PROP(soundOutput, string), PROP(mute, boolean), RAMP_SCHEMA)
+                                               REQUIRED_2(soundOutput, mute)));
+    mSchemas.add("setEqualizer", STRICT_SCHEMA(PROPS_3(PROP(soundOutput, string), PROP(preset, string),
+                                                       OBJARRAY(bands, OBJSCHEMA_4(PROP(type, string),
+                                                                                   PROP(frequency, number),
+                                                                                   PROP(gain, number),
+                                                                                   PROP(q, number))))
+                                               REQUIRED_1(soundOutput)));
+
+    //Apply the volumes saved by the previous run, the HAL defaults on first boot
+    pbnjson::JValue savedOutputs = mStateStore.getSaved("volume");
+    for (AudioOutput& output : mOutputs)
+    {
+        pbnjson::JValue saved;
+        bool muted = false;
+
+        if (savedOutputs.isObject() && savedOutputs[output.name].isObject())
+        {
+            saved = savedOutputs[output.name];
+            muted = saved["muted"].asBool();
+        }
+
+        // Only the equalizer is saved while the HAL default volume is unknown
+        int savedVolume = (saved.isObject() && saved.hasKey("volume")) ? saved["volume"].asNumber<int>() : -1;
+
+        output.volumeController->setChangeHandler([this]() { invalidateStatus(); });
+        if (savedVolume >= MIN_VOLUME && savedVolume <= MAX_VOLUME)
+        {
+            output.volumeController->init(muted, savedVolume);
+        }
+        else
+        {
+            // The HAL may still be initializing, ask it from the executor
+            const VolumeCurve* curve = &output.curve;
+            output.volumeController->init(muted, [umiInstance, curve]()
+            {
+                return curve->getStep(umiInstance->getDefaultVolume());
+            });
+        }
+        output.userMute = muted;
+
+        if (saved.isObject() && saved.hasKey("equalizer"))
+            restoreEqualizer(output, saved["equalizer"]);
+    }
+
+    mStateStore.addSection("volume", [this]() { return buildState(); });
+
+    // Registered last, requests only come in once the outputs are set up
     try
     {
         mService->registerCategory("/audio/volume",LS_CATEGORY_TABLE_NAME(volume),nullptr,nullptr);
@@ -41,52 +153,48 @@ VolumeService::VolumeService(LS::Handle &handle,umiClient* umiInstance)
         LOG_ERROR(MSGID_LS2_SUBSCRIBE_FAILED, 0 , "%s - VolumeService API's registration Failed.",
                   lunaError.what());
     }
+}
 
-    //Initialize outputs list
-    mOutputs.emplace(std::piecewise_construct,
-                     std::forward_as_tuple("alsa"),
-                     std::forward_as_tuple("alsa", &mAmixer));
+VolumeService::~VolumeService()
+{
+    mStateStore.removeSection("volume");
 
-    //Apply initial volumes, all outputs unmuted
-    for (auto& volFuncIter : mOutputs)
-    {
-        // Will be overrided by audiod set volume call
-        volFuncIter.second.volumeController->init(false, umiInstance->getDefaultVolume());
-        volFuncIter.second.userMute = false; //Will be overrided by audiod settings
-    }
+    // Controllers are used by queued HAL calls, let them finish first
+    mRamper.flush();
+    mCoalescer.flush();
+    mHalExecutor.drain();
 }
 
 AudioOutput* VolumeService::findOutput(const std::string &soundOutputType)
 {
-    auto iter = mOutputs.find(soundOutputType);
-    if (iter == mOutputs.end())
-    {
-        return nullptr;
-    }
+    return mOutputs.find(soundOutputType);
+}
 
-    return &(*iter).second;
+AudioOutput* VolumeService::findOutput(AudioRoutes::Id id)
+{
+    return mOutputs.find(id);
 }
 
 bool VolumeService::set(LSMessage& message)
 {
     std::string soundOutputType;
-    int8_t volLevel;
-    int parseError = 0;
+    int volLevel;
+    LSUtils::ParseError parseError;
     LS::Message request(&message);
     pbnjson::JValue requestObj;
 
-    const std::string schema = STRICT_SCHEMA(PROPS_2(PROP(soundOutput,string),PROP(volume,integer))
-                                             REQUIRED_2(soundOutput, volume));
+    SetParams params;
+    LSUtils::FieldDecoder fields;
+    fields.string("soundOutput", params.soundOutput).integer("volume", params.volume);
 
-    if (!LSUtils::parsePayload(request.getPayload(), requestObj, schema, &parseError))
+    if (!LSUtils::parsePayload(request.getPayload(), fields, requestObj, mSchemas.get("set"), &parseError))
     {
-        LSUtils::respondWithError(request, errorSchemavalidation, API_ERROR_SCHEMA_VALIDATION);
+        LSUtils::respondWithError(request, parseError);
         return true;
     }
 
-    soundOutputType = requestObj["soundOutput"].asString();
-    volLevel = requestObj["volume"].asNumber<int>();
-    pbnjson::JValue responseObj = pbnjson::Object();
+    soundOutputType = std::move(params.soundOutput);
+    volLevel = params.volume;
 
     if (volLevel > MAX_VOLUME || volLevel < MIN_VOLUME)
     {
@@ -94,6 +202,22 @@ bool VolumeService::set(LSMessage& message)
         return true;
     }
 
+    RampConfig ramp;
+    if (!parseRamp(requestObj, ramp))
+    {
+        LSUtils::respondWithError(request, errorInvalidParameters, API_ERROR_INVALID_PARAMETERS);
+        return true;
+    }
+
+    if (soundOutputType == allOutputs)
+    {
+        setAllVolumes(volLevel, [this, request, volLevel](const std::vector<AudioOutput*>& failed) mutable
+        {
+            respondGroupChanged(request, failed, "volume", volLevel);
+        }, ramp);
+        return true;
+    }
+
     AudioOutput* speaker = findOutput(soundOutputType);
 
     if (!speaker)
@@ -103,20 +227,10 @@ bool VolumeService::set(LSMessage& message)
         return true;
     }
 
-    if(!speaker->volumeController->setVolume(volLevel))
-    {
-        responseObj.put("returnValue", false);
-        responseObj.put("errorText", errorHALError);
-        responseObj.put("errorCode", API_ERROR_HAL_ERROR);
-    }
-    else
+    setVolume(*speaker, volLevel, [this, request, speaker, volLevel](bool success) mutable
     {
-        responseObj.put("returnValue", true);
-        responseObj.put("soundOutput", soundOutputType);
-        responseObj.put("volume", volLevel);
-    }
-
-    LSUtils::postToClient(request, responseObj);
+        respondVolumeChanged(request, *speaker, volLevel, success);
+    }, ramp);
 
     return true;
 }
@@ -124,20 +238,20 @@ bool VolumeService::set(LSMessage& message)
 bool VolumeService::up(LSMessage& message)
 {
     std::string soundOutputType;
-    int parseError = 0;
+    LSUtils::ParseError parseError;
     LS::Message request(&message);
     pbnjson::JValue requestObj;
 
-    const std::string schema = STRICT_SCHEMA(PROPS_1(PROP(soundOutput, string))
-                                             REQUIRED_1(soundOutput));
+    OutputParams params;
+    LSUtils::FieldDecoder fields;
+    fields.string("soundOutput", params.soundOutput);
 
-    if (!LSUtils::parsePayload(request.getPayload(), requestObj, schema, &parseError)) {
-        LSUtils::respondWithError(request, errorSchemavalidation, API_ERROR_SCHEMA_VALIDATION);
+    if (!LSUtils::parsePayload(request.getPayload(), fields, requestObj, mSchemas.get("up"), &parseError)) {
+        LSUtils::respondWithError(request, parseError);
         return true;
     }
 
-    soundOutputType = requestObj["soundOutput"].asString();
-    pbnjson::JValue responseObj = pbnjson::Object();
+    soundOutputType = std::move(params.soundOutput);
 
     AudioOutput* speaker = findOutput(soundOutputType);
 
@@ -148,7 +262,7 @@ bool VolumeService::up(LSMessage& message)
         return true;
     }
 
-    auto curVolume = speaker->volumeController->getVolume();
+    auto curVolume = getTargetVolume(*speaker);
 
     if (curVolume == MAX_VOLUME)
     {
@@ -156,20 +270,14 @@ bool VolumeService::up(LSMessage& message)
         return true;
     }
 
-    if(!speaker->volumeController->setVolume(curVolume + 1))
-    {
-        responseObj.put("returnValue", false);
-        responseObj.put("errorText", errorHALError);
-        responseObj.put("errorCode", API_ERROR_HAL_ERROR);
-    }
-    else
-    {
-        responseObj.put("returnValue", true);
-        responseObj.put("soundOutput", soundOutputType);
-        responseObj.put("volume", (curVolume + 1));
-    }
+    SpeakerVolume newVolume = curVolume + 1;
+    mRamper.cancel(*speaker);
 
-    LSUtils::postToClient(request, responseObj);
+    mCoalescer.setVolume(*speaker, newVolume, [this, request, speaker, newVolume](bool success) mutable
+    {
+        respondVolumeChanged(request, *speaker, newVolume, success);
+    });
+    invalidateStatus();
 
     return true;
 }
@@ -177,21 +285,21 @@ bool VolumeService::up(LSMessage& message)
 bool VolumeService::down(LSMessage& message)
 {
     std::string soundOutputType;
-    int parseError = 0;
+    LSUtils::ParseError parseError;
     LS::Message request(&message);
     pbnjson::JValue requestObj;
 
-    const std::string schema = STRICT_SCHEMA(PROPS_1(PROP(soundOutput, string))
-                                             REQUIRED_1(soundOutput));
+    OutputParams params;
+    LSUtils::FieldDecoder fields;
+    fields.string("soundOutput", params.soundOutput);
 
-    if (!LSUtils::parsePayload(request.getPayload(), requestObj, schema, &parseError))
+    if (!LSUtils::parsePayload(request.getPayload(), fields, requestObj, mSchemas.get("down"), &parseError))
     {
-        LSUtils::respondWithError(request, errorSchemavalidation, API_ERROR_SCHEMA_VALIDATION);
+        LSUtils::respondWithError(request, parseError);
         return true;
     }
 
-    soundOutputType = requestObj["soundOutput"].asString();
-    pbnjson::JValue responseObj = pbnjson::Object();
+    soundOutputType = std::move(params.soundOutput);
 
     AudioOutput* speaker = findOutput(soundOutputType);
 
@@ -202,7 +310,7 @@ bool VolumeService::down(LSMessage& message)
         return true;
     }
 
-    auto curVolume = speaker->volumeController->getVolume();
+    auto curVolume = getTargetVolume(*speaker);
 
     if (curVolume == MIN_VOLUME)
     {
@@ -210,20 +318,14 @@ bool VolumeService::down(LSMessage& message)
         return true;
     }
 
-    if(!speaker->volumeController->setVolume(curVolume - 1))
-    {
-        responseObj.put("returnValue", false);
-        responseObj.put("errorText", errorHALError);
-        responseObj.put("errorCode", API_ERROR_HAL_ERROR);
-    }
-    else
-    {
-        responseObj.put("returnValue", true);
-        responseObj.put("soundOutput", soundOutputType);
-        responseObj.put("volume", (curVolume - 1));
-    }
+    SpeakerVolume newVolume = curVolume - 1;
+    mRamper.cancel(*speaker);
 
-    LSUtils::postToClient(request, responseObj);
+    mCoalescer.setVolume(*speaker, newVolume, [this, request, speaker, newVolume](bool success) mutable
+    {
+        respondVolumeChanged(request, *speaker, newVolume, success);
+    });
+    invalidateStatus();
 
     return true;
 }
@@ -232,23 +334,39 @@ bool VolumeService::muteSoundOut(LSMessage& message)
 {
     std::string soundOutputType;
     bool muteFlag = false;
-    int parseError = 0;
+    LSUtils::ParseError parseError;
 
     LS::Message request(&message);
     pbnjson::JValue requestObj;
 
-    const std::string schema = STRICT_SCHEMA(PROPS_2(PROP(soundOutput, string),PROP(mute, boolean))
-                                             REQUIRED_2(soundOutput,mute));
+    MuteSoundOutParams params;
+    LSUtils::FieldDecoder fields;
+    fields.string("soundOutput", params.soundOutput).boolean("mute", params.mute);
 
-    if (!LSUtils::parsePayload(request.getPayload(), requestObj, schema, &parseError))
+    if (!LSUtils::parsePayload(request.getPayload(), fields, requestObj, mSchemas.get("muteSoundOut"), &parseError))
     {
-        LSUtils::respondWithError(request, errorSchemavalidation, API_ERROR_SCHEMA_VALIDATION);
+        LSUtils::respondWithError(request, parseError);
         return true;
     }
 
-    soundOutputType = requestObj["soundOutput"].asString();
-    muteFlag = requestObj["mute"].asBool();
-    pbnjson::JValue responseObj = pbnjson::Object();
+    soundOutputType = std::move(params.soundOutput);
+    muteFlag = params.mute;
+
+    RampConfig ramp;
+    if (!parseRamp(requestObj, ramp))
+    {
+        LSUtils::respondWithError(request, errorInvalidParameters, API_ERROR_INVALID_PARAMETERS);
+        return true;
+    }
+
+    if (soundOutputType == allOutputs)
+    {
+        setAllMutes(muteFlag, [this, request, muteFlag](const std::vector<AudioOutput*>& failed) mutable
+        {
+            respondGroupChanged(request, failed, "mute", muteFlag);
+        }, ramp);
+        return true;
+    }
 
     AudioOutput* speaker = findOutput(soundOutputType);
 
@@ -259,54 +377,402 @@ bool VolumeService::muteSoundOut(LSMessage& message)
         return true;
     }
 
-    if(speaker->userMute != muteFlag && (!speaker->volumeController->setMute(muteFlag)))
+    setMute(*speaker, muteFlag, [request, speaker, muteFlag](bool success) mutable
+    {
+        if (!success)
+        {
+            LSUtils::respondWithError(request, errorHALError, API_ERROR_HAL_ERROR);
+            return;
+        }
+
+        LSUtils::postToClient(request, LSUtils::ResponseWriter::instance().begin(true)
+                                           .add("soundOutput", speaker->name)
+                                           .add("mute", muteFlag)
+                                           .end());
+    }, ramp);
+
+    return true;
+}
+
+bool VolumeService::setEqualizer(LSMessage& message)
+{
+    LS::Message request(&message);
+    pbnjson::JValue requestObj;
+    LSUtils::ParseError parseError;
+
+    if (!LSUtils::parsePayload(request.getPayload(), requestObj, mSchemas.get("setEqualizer"), &parseError))
+    {
+        LSUtils::respondWithError(request, parseError);
+        return true;
+    }
+
+    AudioOutput* speaker = findOutput(requestObj["soundOutput"].asString());
+
+    if (!speaker)
+    {
+        LSUtils::respondWithError(request, errorInvalidVolumeControl, API_ERROR_INVALID_VOLUME_CONTROL);
+        return true;
+    }
+
+    // Either a preset or the bands
+    bool applied = false;
+    std::vector<EqBand> bands;
+
+    if (requestObj.hasKey("preset") && !requestObj.hasKey("bands"))
+        applied = speaker->equalizer.setPreset(requestObj["preset"].asString());
+    else if (requestObj.hasKey("bands") && !requestObj.hasKey("preset"))
+        applied = Equalizer::parseBands(requestObj["bands"], bands) && speaker->equalizer.setBands(bands);
+
+    if (!applied)
+    {
+        LOG_WARNING(MSGID_CONFIG_EQUALIZER_VALUES_ERROR, 0, "Invalid equalizer settings for %s",
+                    speaker->name.c_str());
+        LSUtils::respondWithError(request, errorInvalidParameters, API_ERROR_INVALID_PARAMETERS);
+        return true;
+    }
+
+    invalidateStatus();
+    notifyStatus(*speaker);
+
+    if (mEqualizerHandler)
+        mEqualizerHandler(*speaker);
+
+    pbnjson::JValue responseObj = pbnjson::Object();
+    responseObj.put("returnValue", true);
+    responseObj.put("soundOutput", speaker->name);
+    responseObj.put("equalizer", speaker->equalizer.toJson());
+    LSUtils::postToClient(request, responseObj);
+
+    return true;
+}
+
+void VolumeService::restoreEqualizer(AudioOutput& output, const pbnjson::JValue& saved)
+{
+    std::vector<EqBand> bands;
+    std::string preset = saved["preset"].asString();
+
+    bool restored = ("custom" == preset) ? Equalizer::parseBands(saved["bands"], bands) &&
+                                           output.equalizer.setBands(bands)
+                                         : output.equalizer.setPreset(preset);
+    if (!restored)
+    {
+        LOG_WARNING(MSGID_CONFIG_EQUALIZER_ERROR, 0, "Not restoring the invalid equalizer of %s",
+                    output.name.c_str());
+    }
+}
+
+SpeakerVolume VolumeService::getTargetVolume(const AudioOutput& output) const
+{
+    SpeakerVolume volume;
+
+    if (mRamper.getTargetVolume(output, volume))
+        return volume;
+
+    return mCoalescer.getTargetVolume(output);
+}
+
+void VolumeService::setVolume(AudioOutput& output, SpeakerVolume volume, IVolumeController::Completion done,
+                              const RampConfig& ramp)
+{
+    mCoalescer.cancel(output);
+    invalidateStatus();
+
+    if (0 == ramp.durationMs)
+    {
+        mRamper.cancel(output);
+        output.volumeController->setVolume(volume, [this, &output, done](bool success)
+        {
+            if (success)
+                notifyStatus(output);
+            if (done)
+                done(success);
+        });
+        return;
+    }
+
+    mRamper.ramp(output, output.volumeController->getVolume(), volume, volume, ramp,
+                 [this, &output, done](VolumeRamper::Result result)
+    {
+        // A request replacing the ramp notifies itself
+        if (VolumeRamper::Result::DONE == result)
+            notifyStatus(output);
+        if (done)
+            done(VolumeRamper::Result::FAILED != result);
+    });
+}
+
+void VolumeService::setMute(AudioOutput& output, bool mute, IVolumeController::Completion done,
+                            const RampConfig& ramp)
+{
+    // userMute tracks the last request, so that a following opposite
+    // request is not mistaken for a no-op while this one is in flight
+    bool oldUserMute = output.userMute;
+    output.userMute = mute;
+
+    auto rollback = [&output, mute, oldUserMute, done](bool success)
     {
+        if (!success && output.userMute == mute)
+            output.userMute = oldUserMute;
+
+        if (done)
+            done(success);
+    };
+
+    bool muted = output.userMute || mOutputsMuted;
+
+    // Nothing to fade when the output stays as it is
+    if (0 == ramp.durationMs || (muted == output.volumeController->getMute() && !mRamper.isRamping(output)))
+        applyMute(output, rollback);
+    else
+        fadeMute(output, ramp, rollback);
+}
+
+void VolumeService::setAllVolumes(SpeakerVolume volume, GroupCompletion done, const RampConfig& ramp)
+{
+    forEachOutput([this, volume, ramp](AudioOutput& output, IVolumeController::Completion outputDone)
+                  {
+                      setVolume(output, volume, outputDone, ramp);
+                  }, done);
+}
+
+void VolumeService::setAllMutes(bool mute, GroupCompletion done, const RampConfig& ramp)
+{
+    forEachOutput([this, mute, ramp](AudioOutput& output, IVolumeController::Completion outputDone)
+                  {
+                      setMute(output, mute, outputDone, ramp);
+                  }, done);
+}
+
+void VolumeService::muteOutputs()
+{
+    mOutputsMuted = true;
+    forEachOutput([this](AudioOutput& output, IVolumeController::Completion outputDone)
+                  {
+                      applyMute(output, outputDone);
+                  },
+                  [](const std::vector<AudioOutput*>& failed)
+                  {
+                      for (AudioOutput* output : failed)
+                          LOG_ERROR(MSGID_CONFIG_VOLUME_ERROR, 0, "Failed to mute %s", output->name.c_str());
+                  });
+}
+
+void VolumeService::unmuteOutputs()
+{
+    mOutputsMuted = false;
+    forEachOutput([this](AudioOutput& output, IVolumeController::Completion outputDone)
+                  {
+                      applyMute(output, outputDone);
+                  },
+                  [](const std::vector<AudioOutput*>& failed)
+                  {
+                      for (AudioOutput* output : failed)
+                          LOG_ERROR(MSGID_CONFIG_VOLUME_ERROR, 0, "Failed to unmute %s", output->name.c_str());
+                  });
+}
+
+void VolumeService::applyMute(AudioOutput& output, IVolumeController::Completion done)
+{
+    output.volumeController->setMute(output.userMute || mOutputsMuted, [this, &output, done](bool success)
+    {
+        if (success)
+            notifyStatus(output);
+
+        if (done)
+            done(success);
+    });
+}
+
+void VolumeService::fadeMute(AudioOutput& output, const RampConfig& ramp, IVolumeController::Completion done)
+{
+    IVolumeController* controller = output.volumeController;
+    SpeakerVolume volume = getTargetVolume(output);
+
+    mCoalescer.cancel(output);
+
+    if (output.userMute || mOutputsMuted)
+    {
+        // Fade out, mute, then put the volume back for the next unmute
+        mRamper.ramp(output, controller->getVolume(), MIN_VOLUME, volume, ramp,
+                     [this, &output, volume, done](VolumeRamper::Result result)
+        {
+            applyMute(output, [&output, volume, result, done](bool success)
+            {
+                // A request replacing the fade set the volume itself
+                if (VolumeRamper::Result::SUPERSEDED != result)
+                    output.volumeController->setVolume(volume);
+                if (done)
+                    done(success);
+            });
+        });
+    }
+    else
+    {
+        // Fade in from silence, or from where a fade out was stopped
+        SpeakerVolume start = controller->getVolume();
+        if (controller->getMute())
+        {
+            start = MIN_VOLUME;
+            controller->setVolume(MIN_VOLUME);
+        }
+
+        applyMute(output, nullptr);
+        mRamper.ramp(output, start, volume, volume, ramp, [this, &output, done](VolumeRamper::Result result)
+        {
+            if (VolumeRamper::Result::DONE == result)
+                notifyStatus(output);
+            if (done)
+                done(VolumeRamper::Result::FAILED != result);
+        });
+    }
+}
+
+void VolumeService::forEachOutput(const std::function<void(AudioOutput&, IVolumeController::Completion)>& action,
+                                  GroupCompletion done)
+{
+    struct GroupResult
+    {
+        size_t remaining;
+        std::vector<AudioOutput*> failed;
+    };
+
+    if (0 == mOutputs.size())
+    {
+        if (done)
+            done({});
+        return;
+    }
+
+    auto result = std::make_shared<GroupResult>();
+    result->remaining = mOutputs.size();
+
+    // All outputs are started before any completes, their HAL calls are
+    // queued on different keys
+    for (AudioOutput& output : mOutputs)
+    {
+        AudioOutput* outputPtr = &output;
+        action(output, [result, outputPtr, done](bool success)
+        {
+            if (!success)
+                result->failed.push_back(outputPtr);
+            if (0 == --result->remaining && done)
+                done(result->failed);
+        });
+    }
+}
+
+void VolumeService::respondGroupChanged(LS::Message& request, const std::vector<AudioOutput*>& failed,
+                                        const char* key, const pbnjson::JValue& value)
+{
+    pbnjson::JValue responseObj = pbnjson::Object();
+
+    if (!failed.empty())
+    {
+        pbnjson::JArray failedOutputs;
+        for (AudioOutput* output : failed)
+            failedOutputs.append(output->name);
+
         responseObj.put("returnValue", false);
         responseObj.put("errorText", errorHALError);
         responseObj.put("errorCode", API_ERROR_HAL_ERROR);
+        responseObj.put("failedSoundOutputs", failedOutputs);
     }
     else
     {
-        speaker->userMute = muteFlag;
         responseObj.put("returnValue", true);
-        responseObj.put("soundOutput", soundOutputType);
-        responseObj.put("mute", muteFlag);
+        responseObj.put("soundOutput", allOutputs);
+        responseObj.put(key, value);
     }
 
     LSUtils::postToClient(request, responseObj);
+}
 
-    return true;
+void VolumeService::respondVolumeChanged(LS::Message& request, AudioOutput& speaker, SpeakerVolume volume,
+                                         bool success)
+{
+    if (!success)
+    {
+        LSUtils::respondWithError(request, errorHALError, API_ERROR_HAL_ERROR);
+        return;
+    }
+
+    LSUtils::postToClient(request, LSUtils::ResponseWriter::instance().begin(true)
+                                       .add("soundOutput", speaker.name)
+                                       .add("volume", static_cast<int>(volume))
+                                       .end());
 }
 
 bool VolumeService::getStatus(LSMessage& message)
 {
     LS::Message request(&message);
     pbnjson::JValue requestObj;
-    int parseError = 0;
-
-    const std::string schema = STRICT_SCHEMA(PROPS_0());
+    LSUtils::ParseError parseError;
 
-    if (!LSUtils::parsePayload(request.getPayload(), requestObj, schema, &parseError))
+    if (!LSUtils::parsePayload(request.getPayload(), requestObj, mSchemas.get("getStatus"), &parseError))
     {
-        LSUtils::respondWithError(request, errorSchemavalidation, API_ERROR_SCHEMA_VALIDATION);
+        LSUtils::respondWithError(request, parseError);
         return true;
     }
 
-    pbnjson::JValue response = this->buildAudioStatus();
+    bool subscribed = request.isSubscription();
 
-    LSUtils::postToClient(request, response);
+    if (subscribed && !mStatusSubscription.subscribe(request))
+    {
+        LSUtils::respondWithError(request, errorUnknown, API_ERROR_UNKNOWN, true);
+        return true;
+    }
+
+    LSUtils::postToClient(request, getStatusPayload(subscribed));
 
     return true;
 }
 
+const std::string& VolumeService::getStatusPayload(bool subscribed)
+{
+    std::string& payload = mStatusPayload[subscribed];
+
+    if (payload.empty())
+    {
+        pbnjson::JValue response = this->buildAudioStatus();
+        if (subscribed)
+        {
+            response.put("subscribed", true);
+        }
+        LSUtils::generatePayload(response, payload);
+    }
+
+    return payload;
+}
+
+void VolumeService::invalidateStatus()
+{
+    mStatusPayload[false].clear();
+    mStatusPayload[true].clear();
+    mStateStore.markDirty();
+}
+
+void VolumeService::notifyStatus(AudioOutput& output)
+{
+    // Subscribers get the initial status from getStatus, updates only
+    // carry the output that changed.
+    pbnjson::JArray status;
+    pbnjson::JValue responseObj = pbnjson::Object();
+
+    status.append(buildAudioStatus(output));
+    responseObj.put("returnValue", true);
+    responseObj.put("subscribed", true);
+    responseObj.put("volumeStatus", status);
+
+    LSUtils::postToSubscriptionPoint(&mStatusSubscription, responseObj);
+}
+
 pbnjson::JValue VolumeService::buildAudioStatus()
 {
     pbnjson::JArray status;
     pbnjson::JValue responseObj = pbnjson::Object();
 
-    for (auto& volFuncIter : mOutputs)
+    for (AudioOutput& output : mOutputs)
     {
-        AudioOutput& output = volFuncIter.second;
         status.append(buildAudioStatus( output));
     }
     responseObj.put("returnValue", true);
@@ -319,9 +785,38 @@ pbnjson::JValue VolumeService::buildAudioStatus(AudioOutput& output)
 {
     pbnjson::JValue responseObj = pbnjson::Object();
 
+    SpeakerVolume volume = getTargetVolume(output);
+
     responseObj.put("soundOutput", output.name);
-    responseObj.put("volume", output.volumeController->getVolume());
+    responseObj.put("volume", volume);
     responseObj.put("muted", output.volumeController->getMute());
+    responseObj.put("curve", output.curve.getTypeName());
+    // Tenths of a dB are as fine as anyone hears
+    responseObj.put("volumeDb", std::round(output.curve.getDb(volume) * 10.0) / 10.0);
+    responseObj.put("equalizer", output.equalizer.toJson());
+    responseObj.put("rate", static_cast<int64_t>(output.rate));
 
     return responseObj;
 }
+
+pbnjson::JValue VolumeService::buildState()
+{
+    pbnjson::JValue state = pbnjson::Object();
+
+    for (AudioOutput& output : mOutputs)
+    {
+        pbnjson::JValue outputState = pbnjson::Object();
+
+        outputState.put("equalizer", output.equalizer.toJson());
+
+        // Not saved before the HAL default is known, the next start asks again
+        if (output.volumeController->isVolumeKnown())
+        {
+            outputState.put("volume", getTargetVolume(output));
+            outputState.put("muted", output.userMute);
+        }
+        state.put(output.name, outputState);
+    }
+
+    return state;
+}
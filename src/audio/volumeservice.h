@@ -18,31 +18,34 @@
 #ifndef VOLUME_SERVICE_H
 #define VOLUME_SERVICE_H
 
+#include <functional>
 #include <string>
-#include <unordered_map>
+#include <utility>
+#include <vector>
 #include <luna-service2/lunaservice.hpp>
 
 #include "ivolumecontroller.h"
-#include "amixercontroller.h"
+#include "outputregistry.h"
+#include "volumecoalescer.h"
+#include "volumeramper.h"
+#include "halexecutor.h"
+#include "statestore.h"
 #include "utils.h"
 
-struct AudioOutput
-{
-    AudioOutput(const std::string& _name, IVolumeController* _volumeController)
-            : name(_name)
-            , userMute(true)
-            , volumeController(_volumeController)
-    {};
-
-    std::string name;
-    bool userMute;
-    IVolumeController* volumeController;
-};
-
 class VolumeService final
 {
 public:
-    VolumeService(LS::Handle &handle,umiClient* umiInstance);
+    /**
+     * Outputs start with the volume and mute saved in stateStore.
+     *
+     * @param outputs outputs to create, see OutputRegistry
+     * @param volumeWindowMs window in which volume up/down requests on an
+     *        output are merged into one HAL write, 0 to write each one.
+     */
+    VolumeService(LS::Handle &handle,umiClient* umiInstance, HalExecutor& halExecutor,
+                  StateStore& stateStore, const std::vector<OutputConfig>& outputs,
+                  unsigned int volumeWindowMs);
+    ~VolumeService();
     VolumeService(const VolumeService &) = delete;
     VolumeService &operator=(const VolumeService &) = delete;
 
@@ -52,6 +55,7 @@ public:
     bool down(LSMessage& message);
     bool muteSoundOut(LSMessage& message);
     bool getStatus(LSMessage& message);
+    bool setEqualizer(LSMessage& message);
 
     // Call after media streams are set up to unmute outputs.
     void unmuteOutputs();
@@ -59,16 +63,97 @@ public:
     // Call after media streams are closed to mute outputs.
     void muteOutputs();
 
+    AudioOutput* findOutput(const std::string &soundOutputType);
+    AudioOutput* findOutput(AudioRoutes::Id id);
+
+    /**
+     * Called after setEqualizer changed the equalizer of an output.
+     */
+    void setEqualizerHandler(std::function<void(AudioOutput&)> handler)
+    {
+        mEqualizerHandler = std::move(handler);
+    }
+
+    // Volume the output has or is about to have
+    SpeakerVolume getTargetVolume(const AudioOutput& output) const;
+
+    /**
+     * Same as the set and muteSoundOut methods. Subscribers are notified
+     * on success and done gets the HAL result. With a ramp the volume
+     * fades to its new level, a mute fades out before muting and an
+     * unmute fades in from silence.
+     */
+    void setVolume(AudioOutput& output, SpeakerVolume volume, IVolumeController::Completion done,
+                   const RampConfig& ramp = RampConfig());
+    void setMute(AudioOutput& output, bool mute, IVolumeController::Completion done,
+                 const RampConfig& ramp = RampConfig());
+
+    /**
+     * Called on the main loop once every output of a group operation is
+     * done, with the outputs whose HAL call failed.
+     */
+    using GroupCompletion = std::function<void(const std::vector<AudioOutput*>& failed)>;
+
+    /**
+     * setVolume()/setMute() on every output at once. The HAL calls of the
+     * outputs are queued together and run in parallel on the HAL workers.
+     * Same as the set and muteSoundOut methods with soundOutput "all".
+     */
+    void setAllVolumes(SpeakerVolume volume, GroupCompletion done, const RampConfig& ramp = RampConfig());
+    void setAllMutes(bool mute, GroupCompletion done, const RampConfig& ramp = RampConfig());
+
 private:
     // Data members
     LS::Handle *mService;
-    AmixerController mAmixer;
+    HalExecutor& mHalExecutor;
+    StateStore& mStateStore;
+    LSUtils::SchemaRegistry mSchemas;
+    LS::SubscriptionPoint mStatusSubscription;
+
+    OutputRegistry mOutputs;
 
-    std::unordered_map<std::string, AudioOutput> mOutputs;
+    // Set between muteOutputs() and unmuteOutputs(), outputs stay muted
+    // whatever the user asks
     bool mOutputsMuted;
 
+    std::function<void(AudioOutput&)> mEqualizerHandler;
+
+    // Declared after the outputs, pending writes are flushed on destruction
+    VolumeCoalescer mCoalescer;
+    VolumeRamper mRamper;
+
+    // Serialized getStatus replies without and with "subscribed", empty
+    // when state changed since they were built
+    std::string mStatusPayload[2];
+
+    const std::string& getStatusPayload(bool subscribed);
+    void invalidateStatus();
+
     pbnjson::JValue buildAudioStatus();
     pbnjson::JValue buildAudioStatus(AudioOutput& output);
-    AudioOutput* findOutput(const std::string &soundOutputType);
+    pbnjson::JValue buildState();
+
+    // Apply an equalizer saved by buildState()
+    void restoreEqualizer(AudioOutput& output, const pbnjson::JValue& saved);
+
+    void respondVolumeChanged(LS::Message& request, AudioOutput& speaker, SpeakerVolume volume, bool success);
+
+    // Post the status of a changed output to getStatus subscribers
+    void notifyStatus(AudioOutput& output);
+
+    // Mute the output as required by userMute and mOutputsMuted
+    void applyMute(AudioOutput& output, IVolumeController::Completion done);
+
+    // Same, fading the volume out before muting or in after unmuting
+    void fadeMute(AudioOutput& output, const RampConfig& ramp, IVolumeController::Completion done);
+
+    // Run action on every output, each with its own HAL executor key so
+    // their HAL calls do not wait for one another
+    void forEachOutput(const std::function<void(AudioOutput&, IVolumeController::Completion)>& action,
+                       GroupCompletion done);
+
+    // Reply to a group operation, listing the outputs that failed
+    void respondGroupChanged(LS::Message& request, const std::vector<AudioOutput*>& failed,
+                             const char* key, const pbnjson::JValue& value);
 };
 #endif
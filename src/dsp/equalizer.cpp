@@ -0,0 +1,461 @@
+// Copyright (c) 2018 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+
+#include <cmath>
+#include <cstring>
+#include "logging.h"
+#include "equalizer.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define EQ_KERNELS_X86
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define EQ_KERNELS_NEON
+#endif
+
+namespace {
+
+const float defaultQ = 0.707f;
+
+// Limits of the bands clients may set
+const float minFrequency = 10.0f;
+const float maxFrequency = 24000.0f;
+const float maxGainDb = 24.0f;
+const float minQ = 0.1f;
+const float maxQ = 10.0f;
+
+// State this small decays into denormals, which are very slow to compute with
+const float denormalThreshold = 1e-15f;
+
+const struct
+{
+    EqBandType type;
+    const char* name;
+} BAND_TYPES[] = {
+    { EqBandType::PEAKING, "peaking" },
+    { EqBandType::LOW_SHELF, "lowShelf" },
+    { EqBandType::HIGH_SHELF, "highShelf" },
+    { EqBandType::LOW_PASS, "lowPass" },
+    { EqBandType::HIGH_PASS, "highPass" },
+};
+
+const size_t MAX_PRESET_BANDS = 3;
+
+const struct
+{
+    const char* name;
+    size_t bandCount;
+    EqBand bands[MAX_PRESET_BANDS];
+} PRESETS[] = {
+    { "flat", 0, {} },
+    { "bass", 1, { { EqBandType::LOW_SHELF, 100.0f, 6.0f, defaultQ } } },
+    { "treble", 1, { { EqBandType::HIGH_SHELF, 8000.0f, 6.0f, defaultQ } } },
+    { "voice", 3, { { EqBandType::HIGH_PASS, 100.0f, 0.0f, defaultQ },
+                    { EqBandType::PEAKING, 300.0f, -2.0f, 1.0f },
+                    { EqBandType::PEAKING, 2500.0f, 4.0f, 1.0f } } },
+    { "loudness", 2, { { EqBandType::LOW_SHELF, 100.0f, 6.0f, defaultQ },
+                       { EqBandType::HIGH_SHELF, 10000.0f, 4.0f, defaultQ } } },
+};
+
+const char* getBandTypeName(EqBandType type)
+{
+    for (const auto& entry : BAND_TYPES)
+    {
+        if (entry.type == type)
+            return entry.name;
+    }
+    return "";
+}
+
+void flushDenormals(BiquadState& state)
+{
+    for (int lane = 0; lane < 4; lane++)
+    {
+        if (fabsf(state.z1[lane]) < denormalThreshold)
+            state.z1[lane] = 0.0f;
+        if (fabsf(state.z2[lane]) < denormalThreshold)
+            state.z2[lane] = 0.0f;
+    }
+}
+
+// Robert Bristow-Johnson's audio EQ cookbook
+BiquadCoefficients computeCoefficients(const EqBand& band, unsigned int rate)
+{
+    double a = pow(10.0, band.gainDb / 40.0);
+    double w0 = 2.0 * M_PI * band.frequency / rate;
+    double cosW0 = cos(w0);
+    double alpha = sin(w0) / (2.0 * band.q);
+    double shelf = 2.0 * sqrt(a) * alpha;
+    double b0, b1, b2, a0, a1, a2;
+
+    switch (band.type)
+    {
+        case EqBandType::PEAKING:
+            b0 = 1.0 + alpha * a;
+            b1 = -2.0 * cosW0;
+            b2 = 1.0 - alpha * a;
+            a0 = 1.0 + alpha / a;
+            a1 = -2.0 * cosW0;
+            a2 = 1.0 - alpha / a;
+            break;
+
+        case EqBandType::LOW_SHELF:
+            b0 = a * ((a + 1.0) - (a - 1.0) * cosW0 + shelf);
+            b1 = 2.0 * a * ((a - 1.0) - (a + 1.0) * cosW0);
+            b2 = a * ((a + 1.0) - (a - 1.0) * cosW0 - shelf);
+            a0 = (a + 1.0) + (a - 1.0) * cosW0 + shelf;
+            a1 = -2.0 * ((a - 1.0) + (a + 1.0) * cosW0);
+            a2 = (a + 1.0) + (a - 1.0) * cosW0 - shelf;
+            break;
+
+        case EqBandType::HIGH_SHELF:
+            b0 = a * ((a + 1.0) + (a - 1.0) * cosW0 + shelf);
+            b1 = -2.0 * a * ((a - 1.0) + (a + 1.0) * cosW0);
+            b2 = a * ((a + 1.0) + (a - 1.0) * cosW0 - shelf);
+            a0 = (a + 1.0) - (a - 1.0) * cosW0 + shelf;
+            a1 = 2.0 * ((a - 1.0) - (a + 1.0) * cosW0);
+            a2 = (a + 1.0) - (a - 1.0) * cosW0 - shelf;
+            break;
+
+        case EqBandType::LOW_PASS:
+            b0 = (1.0 - cosW0) / 2.0;
+            b1 = 1.0 - cosW0;
+            b2 = (1.0 - cosW0) / 2.0;
+            a0 = 1.0 + alpha;
+            a1 = -2.0 * cosW0;
+            a2 = 1.0 - alpha;
+            break;
+
+        default:
+            b0 = (1.0 + cosW0) / 2.0;
+            b1 = -(1.0 + cosW0);
+            b2 = (1.0 + cosW0) / 2.0;
+            a0 = 1.0 + alpha;
+            a1 = -2.0 * cosW0;
+            a2 = 1.0 - alpha;
+            break;
+    }
+
+    return BiquadCoefficients{static_cast<float>(b0 / a0), static_cast<float>(b1 / a0), static_cast<float>(b2 / a0),
+                              static_cast<float>(a1 / a0), static_cast<float>(a2 / a0)};
+}
+
+void processScalar(const BiquadCoefficients* coefficients, BiquadState* states, size_t bandCount,
+                   float* samples, size_t frames, unsigned int channels)
+{
+    for (size_t band = 0; band < bandCount; band++)
+    {
+        const BiquadCoefficients c = coefficients[band];
+        BiquadState& state = states[band];
+
+        for (unsigned int channel = 0; channel < channels; channel++)
+        {
+            float z1 = state.z1[channel];
+            float z2 = state.z2[channel];
+            float* sample = samples + channel;
+
+            for (size_t frame = 0; frame < frames; frame++, sample += channels)
+            {
+                float x = *sample;
+                float y = c.b0 * x + z1;
+
+                z1 = c.b1 * x - c.a1 * y + z2;
+                z2 = c.b2 * x - c.a2 * y;
+                *sample = y;
+            }
+
+            state.z1[channel] = z1;
+            state.z2[channel] = z2;
+        }
+
+        flushDenormals(state);
+    }
+}
+
+const EqKernels scalarKernels = { "scalar", processScalar };
+
+#ifdef EQ_KERNELS_X86
+
+__attribute__((target("sse2")))
+void processSse2(const BiquadCoefficients* coefficients, BiquadState* states, size_t bandCount,
+                 float* samples, size_t frames, unsigned int channels)
+{
+    // Mono and 3 channels gain nothing from the lanes
+    if (2 != channels && 4 != channels)
+    {
+        processScalar(coefficients, states, bandCount, samples, frames, channels);
+        return;
+    }
+
+    for (size_t band = 0; band < bandCount; band++)
+    {
+        const __m128 b0 = _mm_set1_ps(coefficients[band].b0);
+        const __m128 b1 = _mm_set1_ps(coefficients[band].b1);
+        const __m128 b2 = _mm_set1_ps(coefficients[band].b2);
+        const __m128 a1 = _mm_set1_ps(coefficients[band].a1);
+        const __m128 a2 = _mm_set1_ps(coefficients[band].a2);
+        BiquadState& state = states[band];
+        __m128 z1 = _mm_loadu_ps(state.z1);
+        __m128 z2 = _mm_loadu_ps(state.z2);
+        float* sample = samples;
+
+        for (size_t frame = 0; frame < frames; frame++, sample += channels)
+        {
+            // Stereo frames fill the two low lanes, the others stay zero
+            __m128 x = (4 == channels) ? _mm_loadu_ps(sample)
+                                       : _mm_loadl_pi(_mm_setzero_ps(), reinterpret_cast<const __m64*>(sample));
+            __m128 y = _mm_add_ps(_mm_mul_ps(b0, x), z1);
+
+            z1 = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(b1, x), _mm_mul_ps(a1, y)), z2);
+            z2 = _mm_sub_ps(_mm_mul_ps(b2, x), _mm_mul_ps(a2, y));
+
+            if (4 == channels)
+                _mm_storeu_ps(sample, y);
+            else
+                _mm_storel_pi(reinterpret_cast<__m64*>(sample), y);
+        }
+
+        _mm_storeu_ps(state.z1, z1);
+        _mm_storeu_ps(state.z2, z2);
+        flushDenormals(state);
+    }
+}
+
+const EqKernels sse2Kernels = { "sse2", processSse2 };
+
+#endif
+
+#ifdef EQ_KERNELS_NEON
+
+void processNeon(const BiquadCoefficients* coefficients, BiquadState* states, size_t bandCount,
+                 float* samples, size_t frames, unsigned int channels)
+{
+    if (2 != channels && 4 != channels)
+    {
+        processScalar(coefficients, states, bandCount, samples, frames, channels);
+        return;
+    }
+
+    for (size_t band = 0; band < bandCount; band++)
+    {
+        const float32x4_t b0 = vdupq_n_f32(coefficients[band].b0);
+        const float32x4_t b1 = vdupq_n_f32(coefficients[band].b1);
+        const float32x4_t b2 = vdupq_n_f32(coefficients[band].b2);
+        const float32x4_t a1 = vdupq_n_f32(coefficients[band].a1);
+        const float32x4_t a2 = vdupq_n_f32(coefficients[band].a2);
+        BiquadState& state = states[band];
+        float32x4_t z1 = vld1q_f32(state.z1);
+        float32x4_t z2 = vld1q_f32(state.z2);
+        float* sample = samples;
+
+        for (size_t frame = 0; frame < frames; frame++, sample += channels)
+        {
+            float32x4_t x = (4 == channels) ? vld1q_f32(sample) : vcombine_f32(vld1_f32(sample), vdup_n_f32(0.0f));
+            float32x4_t y = vaddq_f32(vmulq_f32(b0, x), z1);
+
+            z1 = vaddq_f32(vsubq_f32(vmulq_f32(b1, x), vmulq_f32(a1, y)), z2);
+            z2 = vsubq_f32(vmulq_f32(b2, x), vmulq_f32(a2, y));
+
+            if (4 == channels)
+                vst1q_f32(sample, y);
+            else
+                vst1_f32(sample, vget_low_f32(y));
+        }
+
+        vst1q_f32(state.z1, z1);
+        vst1q_f32(state.z2, z2);
+        flushDenormals(state);
+    }
+}
+
+const EqKernels neonKernels = { "neon", processNeon };
+
+#endif
+
+} // namespace
+
+const std::vector<const EqKernels*>& getSupportedEqKernels()
+{
+    static const std::vector<const EqKernels*> supported = []()
+    {
+        std::vector<const EqKernels*> kernels = { &scalarKernels };
+
+#ifdef EQ_KERNELS_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("sse2"))
+            kernels.push_back(&sse2Kernels);
+#endif
+#ifdef EQ_KERNELS_NEON
+        kernels.push_back(&neonKernels);
+#endif
+
+        return kernels;
+    }();
+
+    return supported;
+}
+
+Equalizer::Equalizer()
+        : Equalizer(*getSupportedEqKernels().back())
+{
+}
+
+Equalizer::Equalizer(const EqKernels& kernels)
+        : mKernels(kernels)
+        , mPreset("flat")
+        , mRate(48000)
+        , mChannels(2)
+        , mActiveBands(0)
+{
+    memset(mStates, 0, sizeof(mStates));
+}
+
+bool Equalizer::setBands(const std::vector<EqBand>& bands)
+{
+    if (bands.size() > MAX_BANDS)
+        return false;
+
+    for (const EqBand& band : bands)
+    {
+        if (!isValid(band))
+            return false;
+    }
+
+    mBands = bands;
+    mPreset = "custom";
+    updateCoefficients();
+    return true;
+}
+
+bool Equalizer::setPreset(const std::string& name)
+{
+    for (const auto& preset : PRESETS)
+    {
+        if (name == preset.name)
+        {
+            mBands.assign(preset.bands, preset.bands + preset.bandCount);
+            mPreset = preset.name;
+            updateCoefficients();
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void Equalizer::prepare(unsigned int rate, unsigned int channels)
+{
+    if (channels > MAX_CHANNELS)
+    {
+        LOG_ERROR(MSGID_CONFIG_EQUALIZER_ERROR, 0, "Equalizer bypassed for %u channels, at most %u supported",
+                  channels, MAX_CHANNELS);
+    }
+
+    mRate = rate;
+    mChannels = channels;
+    memset(mStates, 0, sizeof(mStates));
+    updateCoefficients();
+}
+
+void Equalizer::process(float* samples, size_t frames)
+{
+    if (mActiveBands > 0 && mChannels <= MAX_CHANNELS)
+    {
+        mKernels.process(mCoefficients, mStates, mActiveBands, samples, frames, mChannels);
+    }
+}
+
+pbnjson::JValue Equalizer::toJson() const
+{
+    pbnjson::JValue equalizerObj = pbnjson::Object();
+    pbnjson::JArray bands;
+
+    for (const EqBand& band : mBands)
+    {
+        pbnjson::JValue bandObj = pbnjson::Object();
+
+        bandObj.put("type", getBandTypeName(band.type));
+        bandObj.put("frequency", band.frequency);
+        bandObj.put("gain", band.gainDb);
+        bandObj.put("q", band.q);
+        bands.append(bandObj);
+    }
+
+    equalizerObj.put("preset", mPreset);
+    equalizerObj.put("bands", bands);
+
+    return equalizerObj;
+}
+
+bool Equalizer::parseBands(const pbnjson::JValue& bandsArray, std::vector<EqBand>& bands)
+{
+    bands.clear();
+
+    for (ssize_t i = 0; i < bandsArray.arraySize(); i++)
+    {
+        pbnjson::JValue bandObj = bandsArray[i];
+        std::string type = bandObj["type"].asString();
+        EqBand band{EqBandType::PEAKING, 0.0f, 0.0f, defaultQ};
+        bool known = false;
+
+        for (const auto& entry : BAND_TYPES)
+        {
+            if (type == entry.name)
+            {
+                band.type = entry.type;
+                known = true;
+            }
+        }
+
+        if (!known || !bandObj.hasKey("frequency"))
+            return false;
+
+        band.frequency = bandObj["frequency"].asNumber<double>();
+        if (bandObj.hasKey("gain"))
+            band.gainDb = bandObj["gain"].asNumber<double>();
+        if (bandObj.hasKey("q"))
+            band.q = bandObj["q"].asNumber<double>();
+
+        bands.push_back(band);
+    }
+
+    return true;
+}
+
+bool Equalizer::isValid(const EqBand& band)
+{
+    return band.frequency >= minFrequency && band.frequency <= maxFrequency &&
+           fabsf(band.gainDb) <= maxGainDb && band.q >= minQ && band.q <= maxQ;
+}
+
+void Equalizer::updateCoefficients()
+{
+    mActiveBands = 0;
+
+    for (const EqBand& band : mBands)
+    {
+        if (band.frequency >= mRate / 2.0f)
+        {
+            LOG_WARNING(MSGID_CONFIG_EQUALIZER_VALUES_ERROR, 0, "Equalizer band at %.0f Hz bypassed at %u Hz",
+                        band.frequency, mRate);
+            continue;
+        }
+
+        mCoefficients[mActiveBands++] = computeCoefficients(band, mRate);
+    }
+}
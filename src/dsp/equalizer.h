@@ -0,0 +1,168 @@
+// Copyright (c) 2018 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+
+/**
+ * @file equalizer.h
+ *
+ * @brief Parametric equalizer made of cascaded biquads
+ *
+ */
+#ifndef EQUALIZER_H
+#define EQUALIZER_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <pbnjson.hpp>
+
+enum class EqBandType
+{
+    PEAKING,
+    LOW_SHELF,
+    HIGH_SHELF,
+    LOW_PASS,
+    HIGH_PASS
+};
+
+struct EqBand
+{
+    EqBandType type;
+    float frequency;    // Hz, center or corner
+    float gainDb;       // ignored by the pass filters
+    float q;
+};
+
+/**
+ * Normalized by a0, shared by every channel.
+ */
+struct BiquadCoefficients
+{
+    float b0, b1, b2, a1, a2;
+};
+
+/**
+ * Transposed direct form II state of one biquad, one lane per channel.
+ */
+struct BiquadState
+{
+    float z1[4];
+    float z2[4];
+};
+
+/**
+ * One implementation of the filter loop. Each band runs over the whole
+ * buffer before the next, so that its coefficients and state stay in
+ * registers, and the channels of a frame are filtered together in one
+ * vector.
+ */
+struct EqKernels
+{
+    const char* name;
+
+    /**
+     * Filter frames of interleaved samples of channels (1 to 4) through
+     * bandCount biquads, in place.
+     */
+    void (*process)(const BiquadCoefficients* coefficients, BiquadState* states, size_t bandCount,
+                    float* samples, size_t frames, unsigned int channels);
+};
+
+/**
+ * Kernels this CPU runs, from the portable scalar ones to the fastest.
+ */
+const std::vector<const EqKernels*>& getSupportedEqKernels();
+
+/**
+ * Up to MAX_BANDS bands set directly or from a named preset. Coefficients
+ * are computed when the bands or the stream format change, never while
+ * filtering. No bands means flat, and process() does nothing then.
+ */
+class Equalizer
+{
+public:
+    static const size_t MAX_BANDS = 10;
+    static const unsigned int MAX_CHANNELS = 4;
+
+    Equalizer();
+
+    // With given kernels rather than the fastest, for benchmarks
+    explicit Equalizer(const EqKernels& kernels);
+
+    /**
+     * False if there are too many bands or one is out of range, the
+     * current bands are kept then.
+     */
+    bool setBands(const std::vector<EqBand>& bands);
+
+    /**
+     * False if there is no such preset.
+     */
+    bool setPreset(const std::string& name);
+
+    const std::vector<EqBand>& getBands() const
+    {
+        return mBands;
+    }
+
+    // Name of the preset in use, "custom" after setBands()
+    const std::string& getPreset() const
+    {
+        return mPreset;
+    }
+
+    bool isFlat() const
+    {
+        return mBands.empty();
+    }
+
+    /**
+     * Stream format of the following process() calls, clears the filter
+     * state. Bands at or above the Nyquist frequency are bypassed.
+     */
+    void prepare(unsigned int rate, unsigned int channels);
+
+    /**
+     * Filter interleaved samples in place.
+     */
+    void process(float* samples, size_t frames);
+
+    /**
+     * {"preset": ..., "bands": [{"type": ..., "frequency": ..., "gain": ..., "q": ...}, ...]}
+     */
+    pbnjson::JValue toJson() const;
+
+    /**
+     * Read bands in the format of toJson(), false if one is invalid.
+     */
+    static bool parseBands(const pbnjson::JValue& bandsArray, std::vector<EqBand>& bands);
+
+private:
+    static bool isValid(const EqBand& band);
+    void updateCoefficients();
+
+    const EqKernels& mKernels;
+    std::vector<EqBand> mBands;
+    std::string mPreset;
+    unsigned int mRate;
+    unsigned int mChannels;
+
+    // Bands actually filtered, those below Nyquist
+    size_t mActiveBands;
+    BiquadCoefficients mCoefficients[MAX_BANDS];
+    BiquadState mStates[MAX_BANDS];
+};
+#endif
@@ -0,0 +1,229 @@
+// Copyright (c) 2018 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+
+#include <cmath>
+#include "mixkernels.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define MIX_KERNELS_X86
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define MIX_KERNELS_NEON
+#endif
+
+static inline int16_t saturate(float sample)
+{
+    if (sample >= 32767.0f)
+        return INT16_MAX;
+    if (sample <= -32768.0f)
+        return INT16_MIN;
+    return static_cast<int16_t>(lrintf(sample));
+}
+
+static void accumulateScalar(float* acc, const int16_t* in, size_t count, float gain)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        acc[i] += in[i] * gain;
+    }
+}
+
+static void convertScalar(int16_t* out, const float* acc, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        out[i] = saturate(acc[i]);
+    }
+}
+
+static const MixKernels scalarKernels = { "scalar", accumulateScalar, convertScalar };
+
+#ifdef MIX_KERNELS_X86
+
+__attribute__((target("sse2")))
+static void accumulateSse2(float* acc, const int16_t* in, size_t count, float gain)
+{
+    const __m128 gains = _mm_set1_ps(gain);
+    size_t i = 0;
+
+    for (; i + 8 <= count; i += 8)
+    {
+        __m128i samples = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+        // Sign extended by placing each sample in the high half and shifting back
+        __m128 low = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(samples, samples), 16));
+        __m128 high = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(samples, samples), 16));
+
+        _mm_storeu_ps(acc + i, _mm_add_ps(_mm_loadu_ps(acc + i), _mm_mul_ps(low, gains)));
+        _mm_storeu_ps(acc + i + 4, _mm_add_ps(_mm_loadu_ps(acc + i + 4), _mm_mul_ps(high, gains)));
+    }
+
+    accumulateScalar(acc + i, in + i, count - i, gain);
+}
+
+__attribute__((target("sse2")))
+static void convertSse2(int16_t* out, const float* acc, size_t count)
+{
+    const __m128 maximum = _mm_set1_ps(32767.0f);
+    const __m128 minimum = _mm_set1_ps(-32768.0f);
+    size_t i = 0;
+
+    for (; i + 8 <= count; i += 8)
+    {
+        // Clamped first, cvtps returns INT_MIN for anything out of the int range
+        __m128 low = _mm_max_ps(_mm_min_ps(_mm_loadu_ps(acc + i), maximum), minimum);
+        __m128 high = _mm_max_ps(_mm_min_ps(_mm_loadu_ps(acc + i + 4), maximum), minimum);
+        __m128i samples = _mm_packs_epi32(_mm_cvtps_epi32(low), _mm_cvtps_epi32(high));
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), samples);
+    }
+
+    convertScalar(out + i, acc + i, count - i);
+}
+
+__attribute__((target("avx2")))
+static void accumulateAvx2(float* acc, const int16_t* in, size_t count, float gain)
+{
+    const __m256 gains = _mm256_set1_ps(gain);
+    size_t i = 0;
+
+    for (; i + 16 <= count; i += 16)
+    {
+        __m128i lowSamples = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+        __m128i highSamples = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i + 8));
+        __m256 low = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(lowSamples));
+        __m256 high = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(highSamples));
+
+        _mm256_storeu_ps(acc + i, _mm256_add_ps(_mm256_loadu_ps(acc + i), _mm256_mul_ps(low, gains)));
+        _mm256_storeu_ps(acc + i + 8, _mm256_add_ps(_mm256_loadu_ps(acc + i + 8), _mm256_mul_ps(high, gains)));
+    }
+
+    // The tails stay in AVX code, calling the legacy SSE kernels with dirty
+    // upper halves costs a state transition per call
+    for (; i < count; i++)
+    {
+        acc[i] += in[i] * gain;
+    }
+}
+
+__attribute__((target("avx2")))
+static void convertAvx2(int16_t* out, const float* acc, size_t count)
+{
+    const __m256 maximum = _mm256_set1_ps(32767.0f);
+    const __m256 minimum = _mm256_set1_ps(-32768.0f);
+    size_t i = 0;
+
+    for (; i + 16 <= count; i += 16)
+    {
+        __m256 low = _mm256_max_ps(_mm256_min_ps(_mm256_loadu_ps(acc + i), maximum), minimum);
+        __m256 high = _mm256_max_ps(_mm256_min_ps(_mm256_loadu_ps(acc + i + 8), maximum), minimum);
+        // packs works within 128 bit lanes, the permute puts the quarters back in order
+        __m256i samples = _mm256_packs_epi32(_mm256_cvtps_epi32(low), _mm256_cvtps_epi32(high));
+
+        samples = _mm256_permute4x64_epi64(samples, 0xd8);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), samples);
+    }
+
+    for (; i < count; i++)
+    {
+        out[i] = saturate(acc[i]);
+    }
+}
+
+static const MixKernels sse2Kernels = { "sse2", accumulateSse2, convertSse2 };
+static const MixKernels avx2Kernels = { "avx2", accumulateAvx2, convertAvx2 };
+
+#endif
+
+#ifdef MIX_KERNELS_NEON
+
+static void accumulateNeon(float* acc, const int16_t* in, size_t count, float gain)
+{
+    size_t i = 0;
+
+    for (; i + 8 <= count; i += 8)
+    {
+        int16x8_t samples = vld1q_s16(in + i);
+        float32x4_t low = vcvtq_f32_s32(vmovl_s16(vget_low_s16(samples)));
+        float32x4_t high = vcvtq_f32_s32(vmovl_s16(vget_high_s16(samples)));
+
+        vst1q_f32(acc + i, vmlaq_n_f32(vld1q_f32(acc + i), low, gain));
+        vst1q_f32(acc + i + 4, vmlaq_n_f32(vld1q_f32(acc + i + 4), high, gain));
+    }
+
+    accumulateScalar(acc + i, in + i, count - i, gain);
+}
+
+static inline int32x4_t roundToInt(float32x4_t samples)
+{
+#ifdef __aarch64__
+    return vcvtnq_s32_f32(samples);
+#else
+    // ARMv7 only truncates, half away from zero is added first
+    float32x4_t half = vbslq_f32(vcltq_f32(samples, vdupq_n_f32(0.0f)), vdupq_n_f32(-0.5f), vdupq_n_f32(0.5f));
+    return vcvtq_s32_f32(vaddq_f32(samples, half));
+#endif
+}
+
+static void convertNeon(int16_t* out, const float* acc, size_t count)
+{
+    size_t i = 0;
+
+    // The conversion and the narrowing both saturate
+    for (; i + 8 <= count; i += 8)
+    {
+        int16x4_t low = vqmovn_s32(roundToInt(vld1q_f32(acc + i)));
+        int16x4_t high = vqmovn_s32(roundToInt(vld1q_f32(acc + i + 4)));
+
+        vst1q_s16(out + i, vcombine_s16(low, high));
+    }
+
+    convertScalar(out + i, acc + i, count - i);
+}
+
+static const MixKernels neonKernels = { "neon", accumulateNeon, convertNeon };
+
+#endif
+
+const std::vector<const MixKernels*>& getSupportedMixKernels()
+{
+    static const std::vector<const MixKernels*> supported = []()
+    {
+        std::vector<const MixKernels*> kernels = { &scalarKernels };
+
+#ifdef MIX_KERNELS_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("sse2"))
+            kernels.push_back(&sse2Kernels);
+        if (__builtin_cpu_supports("avx2"))
+            kernels.push_back(&avx2Kernels);
+#endif
+#ifdef MIX_KERNELS_NEON
+        kernels.push_back(&neonKernels);
+#endif
+
+        return kernels;
+    }();
+
+    return supported;
+}
+
+const MixKernels& getMixKernels()
+{
+    static const MixKernels& kernels = *getSupportedMixKernels().back();
+    return kernels;
+}
@@ -0,0 +1,64 @@
+// Copyright (c) 2018 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+
+/**
+ * @file mixkernels.h
+ *
+ * @brief Gain and accumulate kernels of the software mixer
+ *
+ */
+#ifndef MIX_KERNELS_H
+#define MIX_KERNELS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * One implementation of the two loops mixing spends its time in. Samples
+ * are interleaved signed 16 bit, the accumulator holds floats so that
+ * summing many inputs does not clip before the final conversion.
+ */
+struct MixKernels
+{
+    const char* name;
+
+    /**
+     * acc[i] += in[i] * gain for count samples.
+     */
+    void (*accumulate)(float* acc, const int16_t* in, size_t count, float gain);
+
+    /**
+     * out[i] = acc[i] rounded and saturated to 16 bit, for count samples.
+     */
+    void (*convert)(int16_t* out, const float* acc, size_t count);
+};
+
+/**
+ * Kernels this CPU runs, from the portable scalar ones to the fastest.
+ * SIMD kernels are built for their instruction set whatever the compiler
+ * flags and picked at run time, so one binary serves every CPU of an
+ * architecture.
+ */
+const std::vector<const MixKernels*>& getSupportedMixKernels();
+
+/**
+ * Fastest kernels of getSupportedMixKernels().
+ */
+const MixKernels& getMixKernels();
+
+#endif
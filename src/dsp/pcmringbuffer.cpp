@@ -0,0 +1,296 @@
+// Copyright (c) 2018 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <new>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include "logging.h"
+#include "pcmringbuffer.h"
+
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC 0x0001U
+#endif
+#ifndef MFD_ALLOW_SEALING
+#define MFD_ALLOW_SEALING 0x0002U
+#endif
+
+namespace {
+
+// "PCMR" and the layout version
+const uint32_t ringMagic = 0x504d5201;
+
+bool isValidFormat(size_t frames, unsigned int channels)
+{
+    return frames > 0 && frames <= PcmRingBuffer::MAX_FRAMES &&
+           channels > 0 && channels <= PcmRingBuffer::MAX_CHANNELS;
+}
+
+size_t roundUpToPowerOfTwo(size_t frames)
+{
+    size_t capacity = 1;
+    while (capacity < frames)
+    {
+        capacity <<= 1;
+    }
+    return capacity;
+}
+
+// Through the system call, C libraries older than the kernel lack memfd_create()
+int createMemfd(const char* name)
+{
+#ifdef SYS_memfd_create
+    return static_cast<int>(syscall(SYS_memfd_create, name, MFD_CLOEXEC | MFD_ALLOW_SEALING));
+#else
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+} // namespace
+
+std::unique_ptr<PcmRingBuffer> PcmRingBuffer::create(size_t frames, unsigned int channels)
+{
+    if (!isValidFormat(frames, channels))
+    {
+        LOG_ERROR(MSGID_RING_BUFFER_ERROR, 0, "Invalid ring of %zu frames of %u channels", frames, channels);
+        return nullptr;
+    }
+
+    size_t capacity = roundUpToPowerOfTwo(frames);
+    size_t mappingSize = getMappingSize(capacity, channels);
+    void* mapping = mmap(nullptr, mappingSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if (MAP_FAILED == mapping)
+    {
+        LOG_ERROR(MSGID_RING_BUFFER_ERROR, 0, "Failed to allocate a ring of %zu frames: %s", capacity,
+                  strerror(errno));
+        return nullptr;
+    }
+
+    return init(mapping, mappingSize, -1, capacity, channels);
+}
+
+std::unique_ptr<PcmRingBuffer> PcmRingBuffer::createShared(size_t frames, unsigned int channels)
+{
+    if (!isValidFormat(frames, channels))
+    {
+        LOG_ERROR(MSGID_RING_BUFFER_ERROR, 0, "Invalid ring of %zu frames of %u channels", frames, channels);
+        return nullptr;
+    }
+
+    size_t capacity = roundUpToPowerOfTwo(frames);
+    size_t mappingSize = getMappingSize(capacity, channels);
+    int fd = createMemfd("pcm-ring");
+
+    if (fd < 0)
+    {
+        LOG_ERROR(MSGID_RING_BUFFER_ERROR, 0, "Failed to create a memfd: %s", strerror(errno));
+        return nullptr;
+    }
+
+    if (ftruncate(fd, static_cast<off_t>(mappingSize)) < 0)
+    {
+        LOG_ERROR(MSGID_RING_BUFFER_ERROR, 0, "Failed to size a memfd to %zu bytes: %s", mappingSize,
+                  strerror(errno));
+        close(fd);
+        return nullptr;
+    }
+
+#ifdef F_ADD_SEALS
+    // A client shrinking the file would fault every later access to the mapping
+    fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL);
+#endif
+
+    void* mapping = mmap(nullptr, mappingSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (MAP_FAILED == mapping)
+    {
+        LOG_ERROR(MSGID_RING_BUFFER_ERROR, 0, "Failed to map a memfd: %s", strerror(errno));
+        close(fd);
+        return nullptr;
+    }
+
+    return init(mapping, mappingSize, fd, capacity, channels);
+}
+
+std::unique_ptr<PcmRingBuffer> PcmRingBuffer::attach(int fd)
+{
+    struct stat info;
+
+    if (fstat(fd, &info) < 0 || info.st_size < static_cast<off_t>(DATA_OFFSET))
+    {
+        LOG_ERROR(MSGID_RING_BUFFER_ERROR, 0, "Descriptor %d is not a ring", fd);
+        return nullptr;
+    }
+
+#ifdef F_GET_SEALS
+    int seals = fcntl(fd, F_GET_SEALS);
+    if (seals < 0 || !(seals & F_SEAL_SHRINK))
+    {
+        LOG_ERROR(MSGID_RING_BUFFER_ERROR, 0, "Ring %d may shrink under its mapping", fd);
+        return nullptr;
+    }
+#endif
+
+    size_t mappingSize = static_cast<size_t>(info.st_size);
+    void* mapping = mmap(nullptr, mappingSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+    if (MAP_FAILED == mapping)
+    {
+        LOG_ERROR(MSGID_RING_BUFFER_ERROR, 0, "Failed to map ring %d: %s", fd, strerror(errno));
+        return nullptr;
+    }
+
+    // Read once, the header stays writable by the other process
+    const Header* header = static_cast<const Header*>(mapping);
+    uint32_t magic = header->magic;
+    size_t capacity = header->capacity;
+    unsigned int channels = header->channels;
+
+    if (magic != ringMagic || !isValidFormat(capacity, channels) || capacity != roundUpToPowerOfTwo(capacity) ||
+        getMappingSize(capacity, channels) > mappingSize)
+    {
+        LOG_ERROR(MSGID_RING_BUFFER_ERROR, 0, "Descriptor %d is not a ring", fd);
+        munmap(mapping, mappingSize);
+        return nullptr;
+    }
+
+    return std::unique_ptr<PcmRingBuffer>(new PcmRingBuffer(mapping, mappingSize, -1, capacity, channels));
+}
+
+std::unique_ptr<PcmRingBuffer> PcmRingBuffer::init(void* mapping, size_t mappingSize, int fd, size_t capacity,
+                                                   unsigned int channels)
+{
+    Header* header = new (mapping) Header();
+
+    header->magic = ringMagic;
+    header->channels = channels;
+    header->capacity = static_cast<uint32_t>(capacity);
+
+    return std::unique_ptr<PcmRingBuffer>(new PcmRingBuffer(mapping, mappingSize, fd, capacity, channels));
+}
+
+PcmRingBuffer::PcmRingBuffer(void* mapping, size_t mappingSize, int fd, size_t capacity, unsigned int channels)
+        : mHeader(static_cast<Header*>(mapping))
+        , mData(reinterpret_cast<int16_t*>(static_cast<char*>(mapping) + DATA_OFFSET))
+        , mMapping(mapping)
+        , mMappingSize(mappingSize)
+        , mFd(fd)
+        , mCapacity(capacity)
+        , mChannels(channels)
+{
+}
+
+PcmRingBuffer::~PcmRingBuffer()
+{
+    munmap(mMapping, mMappingSize);
+
+    if (mFd >= 0)
+    {
+        close(mFd);
+    }
+}
+
+size_t PcmRingBuffer::getMappingSize(size_t capacity, unsigned int channels)
+{
+    return DATA_OFFSET + capacity * channels * sizeof(int16_t);
+}
+
+size_t PcmRingBuffer::push(const int16_t* samples, size_t frames)
+{
+    uint32_t writePos = mHeader->writePos.load(std::memory_order_relaxed);
+    size_t space = mCapacity - getUsed(mHeader->producerReadPos, writePos);
+
+    if (space < frames)
+    {
+        mHeader->producerReadPos = mHeader->readPos.load(std::memory_order_acquire);
+        space = mCapacity - getUsed(mHeader->producerReadPos, writePos);
+    }
+
+    size_t count = std::min(frames, space);
+    if (count < frames)
+    {
+        // Only the producer writes it, no need for an atomic increment
+        mHeader->overruns.store(mHeader->overruns.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    size_t offset = writePos & (mCapacity - 1);
+    size_t firstFrames = std::min(count, mCapacity - offset);
+
+    memcpy(mData + offset * mChannels, samples, firstFrames * mChannels * sizeof(int16_t));
+    memcpy(mData, samples + firstFrames * mChannels, (count - firstFrames) * mChannels * sizeof(int16_t));
+
+    mHeader->writePos.store(writePos + static_cast<uint32_t>(count), std::memory_order_release);
+    return count;
+}
+
+size_t PcmRingBuffer::pop(int16_t* samples, size_t frames)
+{
+    ReadRegions regions;
+    size_t count = peek(frames, regions);
+
+    memcpy(samples, regions.first, regions.firstFrames * mChannels * sizeof(int16_t));
+    memcpy(samples + regions.firstFrames * mChannels, regions.second,
+           regions.secondFrames * mChannels * sizeof(int16_t));
+
+    consume(count);
+    return count;
+}
+
+size_t PcmRingBuffer::peek(size_t frames, ReadRegions& regions)
+{
+    uint32_t readPos = mHeader->readPos.load(std::memory_order_relaxed);
+    size_t available = getUsed(readPos, mHeader->consumerWritePos);
+
+    if (available < frames)
+    {
+        mHeader->consumerWritePos = mHeader->writePos.load(std::memory_order_acquire);
+        available = getUsed(readPos, mHeader->consumerWritePos);
+    }
+
+    size_t count = std::min(frames, available);
+    if (count < frames)
+    {
+        mHeader->underruns.store(mHeader->underruns.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    size_t offset = readPos & (mCapacity - 1);
+
+    regions.first = mData + offset * mChannels;
+    regions.firstFrames = std::min(count, mCapacity - offset);
+    regions.second = mData;
+    regions.secondFrames = count - regions.firstFrames;
+
+    return count;
+}
+
+void PcmRingBuffer::consume(size_t frames)
+{
+    uint32_t readPos = mHeader->readPos.load(std::memory_order_relaxed);
+    mHeader->readPos.store(readPos + static_cast<uint32_t>(frames), std::memory_order_release);
+}
+
+size_t PcmRingBuffer::getReadable() const
+{
+    uint32_t readPos = mHeader->readPos.load(std::memory_order_acquire);
+    return getUsed(readPos, mHeader->writePos.load(std::memory_order_acquire));
+}
@@ -0,0 +1,195 @@
+// Copyright (c) 2018 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+
+/**
+ * @file pcmringbuffer.h
+ *
+ * @brief Lock-free single producer, single consumer queue of PCM frames
+ *
+ */
+#ifndef PCM_RING_BUFFER_H
+#define PCM_RING_BUFFER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+/**
+ * Fixed capacity ring of interleaved signed 16 bit frames between one
+ * producer thread and one consumer thread. push() and pop() never block
+ * nor allocate and finish in a bounded number of steps whatever the other
+ * side does: a full ring takes what fits and counts an overrun, an empty
+ * one gives what it has and counts an underrun.
+ *
+ * The positions, the counters and the frames all live in one mapping. A
+ * private ring is anonymous memory, a shared one is backed by a memfd
+ * that another process maps with attach() to produce or consume from
+ * its side. Nothing the other process writes to a shared ring can make
+ * this one read or write out of its mapping. Only the benchmarks use
+ * shared rings so far, the service has no way to hand a memfd to its
+ * clients and mixer inputs are private.
+ */
+class PcmRingBuffer
+{
+public:
+    static const size_t CACHE_LINE = 64;
+
+    // Largest capacity, in frames
+    static const size_t MAX_FRAMES = 1 << 20;
+    static const unsigned int MAX_CHANNELS = 8;
+
+    /**
+     * Frames ready to be consumed without copying them, the second part
+     * being the start of the ring when the first one reaches its end.
+     */
+    struct ReadRegions
+    {
+        const int16_t* first;
+        size_t firstFrames;
+        const int16_t* second;
+        size_t secondFrames;
+    };
+
+    /**
+     * Ring holding at least frames frames, rounded up to a power of two,
+     * in private memory. nullptr if it cannot be allocated.
+     */
+    static std::unique_ptr<PcmRingBuffer> create(size_t frames, unsigned int channels);
+
+    /**
+     * Same in a memfd, see getFd(). nullptr if the kernel has no memfd.
+     */
+    static std::unique_ptr<PcmRingBuffer> createShared(size_t frames, unsigned int channels);
+
+    /**
+     * Map the ring of a memfd another process created, nullptr if fd is
+     * not one. The descriptor is not kept.
+     */
+    static std::unique_ptr<PcmRingBuffer> attach(int fd);
+
+    ~PcmRingBuffer();
+
+    PcmRingBuffer(const PcmRingBuffer &) = delete;
+    PcmRingBuffer &operator=(const PcmRingBuffer &) = delete;
+
+    /**
+     * Producer side: queue up to frames frames, returns how many fit.
+     */
+    size_t push(const int16_t* samples, size_t frames);
+
+    /**
+     * Consumer side: dequeue up to frames frames into samples, returns
+     * how many there were.
+     */
+    size_t pop(int16_t* samples, size_t frames);
+
+    /**
+     * Consumer side: up to frames frames in place, returns how many. They
+     * stay queued until consume(), and count as an underrun as in pop()
+     * if short.
+     */
+    size_t peek(size_t frames, ReadRegions& regions);
+
+    /**
+     * Consumer side: drop frames frames peek() returned.
+     */
+    void consume(size_t frames);
+
+    // Frames queued, exact from the consumer side and a lower bound from
+    // the producer side
+    size_t getReadable() const;
+
+    size_t getCapacity() const
+    {
+        return mCapacity;
+    }
+
+    unsigned int getChannels() const
+    {
+        return mChannels;
+    }
+
+    uint32_t getOverruns() const
+    {
+        return mHeader->overruns.load(std::memory_order_relaxed);
+    }
+
+    uint32_t getUnderruns() const
+    {
+        return mHeader->underruns.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * memfd of a shared ring, -1 for a private one. Owned by the ring.
+     */
+    int getFd() const
+    {
+        return mFd;
+    }
+
+private:
+    /**
+     * Start of the mapping, shared between processes so made of fixed
+     * size types only. Each side writes only to its own cache line: the
+     * position it advances, its counter and the last position it read
+     * from the other side, which spares reloading the other line while
+     * there is room or data left. Positions count frames and wrap at
+     * 2^32, which a power of two capacity divides.
+     */
+    struct Header
+    {
+        uint32_t magic;
+        uint32_t channels;
+        uint32_t capacity;
+
+        alignas(CACHE_LINE) std::atomic<uint32_t> writePos;
+        std::atomic<uint32_t> overruns;
+        uint32_t producerReadPos;
+
+        alignas(CACHE_LINE) std::atomic<uint32_t> readPos;
+        std::atomic<uint32_t> underruns;
+        uint32_t consumerWritePos;
+    };
+
+    static const size_t DATA_OFFSET = (sizeof(Header) + CACHE_LINE - 1) / CACHE_LINE * CACHE_LINE;
+
+    PcmRingBuffer(void* mapping, size_t mappingSize, int fd, size_t capacity, unsigned int channels);
+
+    static size_t getMappingSize(size_t capacity, unsigned int channels);
+    static std::unique_ptr<PcmRingBuffer> init(void* mapping, size_t mappingSize, int fd, size_t capacity,
+                                               unsigned int channels);
+
+    // Frames queued between two positions, at most the capacity whatever
+    // the other side wrote to them
+    size_t getUsed(uint32_t from, uint32_t to) const
+    {
+        uint32_t used = to - from;
+        return (used < mCapacity) ? used : mCapacity;
+    }
+
+    Header* mHeader;
+    int16_t* mData;
+    void* mMapping;
+    size_t mMappingSize;
+    int mFd;
+
+    // Copied from the header, which a shared ring does not trust
+    size_t mCapacity;
+    unsigned int mChannels;
+};
+#endif
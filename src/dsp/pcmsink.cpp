@@ -0,0 +1,67 @@
+// Copyright (c) 2018 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+
+#include <cerrno>
+#include <cstring>
+#include "logging.h"
+#include "pcmsink.h"
+
+std::unique_ptr<PcmSink> PcmSink::create(const std::string& spec)
+{
+    if (spec.empty() || "null" == spec)
+    {
+        return std::unique_ptr<PcmSink>(new NullPcmSink());
+    }
+
+    std::unique_ptr<FilePcmSink> sink(new FilePcmSink());
+    if (!sink->open(spec))
+    {
+        return std::unique_ptr<PcmSink>(new NullPcmSink());
+    }
+
+    return std::unique_ptr<PcmSink>(sink.release());
+}
+
+FilePcmSink::~FilePcmSink()
+{
+    if (mFile)
+    {
+        fclose(mFile);
+    }
+}
+
+bool FilePcmSink::open(const std::string& path)
+{
+    mFile = fopen(path.c_str(), "wb");
+    if (!mFile)
+    {
+        LOG_ERROR(MSGID_SINK_SETUP_ERROR, 0, "Failed to open mixer output %s: %s", path.c_str(), strerror(errno));
+        return false;
+    }
+
+    return true;
+}
+
+bool FilePcmSink::write(const int16_t* samples, size_t frames, unsigned int channels)
+{
+    if (!mFile)
+    {
+        return false;
+    }
+
+    return fwrite(samples, sizeof(int16_t) * channels, frames, mFile) == frames;
+}
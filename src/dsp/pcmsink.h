@@ -0,0 +1,98 @@
+// Copyright (c) 2018 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+
+/**
+ * @file pcmsink.h
+ *
+ * @brief Where the software mixer writes its output
+ *
+ */
+#ifndef PCM_SINK_H
+#define PCM_SINK_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+
+/**
+ * Receives the mixed PCM, interleaved signed 16 bit in host order.
+ */
+class PcmSink
+{
+public:
+    virtual ~PcmSink() = default;
+
+    /**
+     * False if the frames could not be written, they are dropped then.
+     */
+    virtual bool write(const int16_t* samples, size_t frames, unsigned int channels) = 0;
+
+    virtual const char* getName() const = 0;
+
+    /**
+     * Sink for spec, "null" or empty for a NullPcmSink and a path for a
+     * FilePcmSink. Falls back to a NullPcmSink if the file cannot be opened.
+     */
+    static std::unique_ptr<PcmSink> create(const std::string& spec);
+};
+
+/**
+ * Drops everything, for running the mixer without hardware.
+ */
+class NullPcmSink : public PcmSink
+{
+public:
+    bool write(const int16_t* samples, size_t frames, unsigned int channels) override
+    {
+        return true;
+    }
+
+    const char* getName() const override
+    {
+        return "null";
+    }
+};
+
+/**
+ * Appends raw PCM to a file, which can be played with
+ * aplay -f S16_LE -c CHANNELS -r RATE.
+ */
+class FilePcmSink : public PcmSink
+{
+public:
+    FilePcmSink() = default;
+    ~FilePcmSink();
+
+    FilePcmSink(const FilePcmSink &) = delete;
+    FilePcmSink &operator=(const FilePcmSink &) = delete;
+
+    bool open(const std::string& path);
+
+    bool write(const int16_t* samples, size_t frames, unsigned int channels) override;
+
+    const char* getName() const override
+    {
+        return "file";
+    }
+
+private:
+    FILE* mFile = nullptr;
+};
+
+#endif
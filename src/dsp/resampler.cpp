@@ -0,0 +1,306 @@
+// Copyright (c) 2018 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+
+#include <algorithm>
+#include <cmath>
+#include "resampler.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define RESAMPLE_KERNELS_X86
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define RESAMPLE_KERNELS_NEON
+#endif
+
+namespace {
+
+// Passband as a fraction of the lower Nyquist frequency, the rest is the
+// transition band the TAPS long filter needs
+const double rolloff = 0.9;
+
+// Kaiser window shape, about 80 dB of stopband attenuation
+const double kaiserBeta = 8.0;
+
+unsigned int gcd(unsigned int a, unsigned int b)
+{
+    while (b)
+    {
+        unsigned int rest = a % b;
+        a = b;
+        b = rest;
+    }
+    return a;
+}
+
+// Modified Bessel function of the first kind and order zero
+double besselI0(double x)
+{
+    double sum = 1.0;
+    double term = 1.0;
+
+    for (int k = 1; k < 50 && term > sum * 1e-12; k++)
+    {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+    }
+    return sum;
+}
+
+float dotScalar(const float* coefficients, const float* samples, size_t count)
+{
+    float sum = 0.0f;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        sum += coefficients[i] * samples[i];
+    }
+    return sum;
+}
+
+const ResampleKernels scalarKernels = { "scalar", dotScalar };
+
+#ifdef RESAMPLE_KERNELS_X86
+
+__attribute__((target("sse2")))
+float dotSse2(const float* coefficients, const float* samples, size_t count)
+{
+    // Two sums, so that consecutive multiply-adds do not wait on each other
+    __m128 sum0 = _mm_setzero_ps();
+    __m128 sum1 = _mm_setzero_ps();
+    size_t i = 0;
+
+    for (; i + 8 <= count; i += 8)
+    {
+        sum0 = _mm_add_ps(sum0, _mm_mul_ps(_mm_loadu_ps(coefficients + i), _mm_loadu_ps(samples + i)));
+        sum1 = _mm_add_ps(sum1, _mm_mul_ps(_mm_loadu_ps(coefficients + i + 4), _mm_loadu_ps(samples + i + 4)));
+    }
+
+    __m128 sum = _mm_add_ps(sum0, sum1);
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+
+    return _mm_cvtss_f32(sum) + dotScalar(coefficients + i, samples + i, count - i);
+}
+
+__attribute__((target("avx2")))
+float dotAvx2(const float* coefficients, const float* samples, size_t count)
+{
+    __m256 sum0 = _mm256_setzero_ps();
+    __m256 sum1 = _mm256_setzero_ps();
+    size_t i = 0;
+
+    for (; i + 16 <= count; i += 16)
+    {
+        sum0 = _mm256_add_ps(sum0, _mm256_mul_ps(_mm256_loadu_ps(coefficients + i), _mm256_loadu_ps(samples + i)));
+        sum1 = _mm256_add_ps(sum1, _mm256_mul_ps(_mm256_loadu_ps(coefficients + i + 8),
+                                                 _mm256_loadu_ps(samples + i + 8)));
+    }
+
+    __m256 sum8 = _mm256_add_ps(sum0, sum1);
+    __m128 sum = _mm_add_ps(_mm256_castps256_ps128(sum8), _mm256_extractf128_ps(sum8, 1));
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+
+    float tail = 0.0f;
+
+    for (; i < count; i++)
+    {
+        tail += coefficients[i] * samples[i];
+    }
+
+    return _mm_cvtss_f32(sum) + tail;
+}
+
+const ResampleKernels sse2Kernels = { "sse2", dotSse2 };
+const ResampleKernels avx2Kernels = { "avx2", dotAvx2 };
+
+#endif
+
+#ifdef RESAMPLE_KERNELS_NEON
+
+float dotNeon(const float* coefficients, const float* samples, size_t count)
+{
+    float32x4_t sum0 = vdupq_n_f32(0.0f);
+    float32x4_t sum1 = vdupq_n_f32(0.0f);
+    size_t i = 0;
+
+    for (; i + 8 <= count; i += 8)
+    {
+        sum0 = vmlaq_f32(sum0, vld1q_f32(coefficients + i), vld1q_f32(samples + i));
+        sum1 = vmlaq_f32(sum1, vld1q_f32(coefficients + i + 4), vld1q_f32(samples + i + 4));
+    }
+
+    float32x4_t sum4 = vaddq_f32(sum0, sum1);
+    float32x2_t sum = vadd_f32(vget_low_f32(sum4), vget_high_f32(sum4));
+
+    return vget_lane_f32(vpadd_f32(sum, sum), 0) + dotScalar(coefficients + i, samples + i, count - i);
+}
+
+const ResampleKernels neonKernels = { "neon", dotNeon };
+
+#endif
+
+} // namespace
+
+const std::vector<const ResampleKernels*>& getSupportedResampleKernels()
+{
+    static const std::vector<const ResampleKernels*> supported = []()
+    {
+        std::vector<const ResampleKernels*> kernels = { &scalarKernels };
+
+#ifdef RESAMPLE_KERNELS_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("sse2"))
+            kernels.push_back(&sse2Kernels);
+        if (__builtin_cpu_supports("avx2"))
+            kernels.push_back(&avx2Kernels);
+#endif
+#ifdef RESAMPLE_KERNELS_NEON
+        kernels.push_back(&neonKernels);
+#endif
+
+        return kernels;
+    }();
+
+    return supported;
+}
+
+bool Resampler::isSupported(unsigned int inputRate, unsigned int outputRate)
+{
+    return inputRate > 0 && outputRate > 0 && outputRate / gcd(inputRate, outputRate) <= MAX_PHASES;
+}
+
+Resampler::Resampler(unsigned int inputRate, unsigned int outputRate, unsigned int channels)
+        : Resampler(inputRate, outputRate, channels, *getSupportedResampleKernels().back())
+{
+}
+
+Resampler::Resampler(unsigned int inputRate, unsigned int outputRate, unsigned int channels,
+                     const ResampleKernels& kernels)
+        : mKernels(kernels)
+        , mInputRate(inputRate)
+        , mOutputRate(outputRate)
+        , mChannels(channels)
+        , mUp(outputRate / gcd(inputRate, outputRate))
+        , mDown(inputRate / gcd(inputRate, outputRate))
+        , mHistory(channels)
+{
+    computePhases();
+    reset();
+}
+
+size_t Resampler::getMaxOutputFrames(size_t inputFrames) const
+{
+    // One more for the phase left over from the previous block
+    return (inputFrames * mUp + mDown - 1) / mDown + 1;
+}
+
+size_t Resampler::process(const float* input, size_t frames, float* output)
+{
+    size_t written = 0;
+
+    for (unsigned int channel = 0; channel < mChannels; channel++)
+    {
+        std::vector<float>& history = mHistory[channel];
+
+        history.resize(TAPS - 1 + frames);
+        for (size_t frame = 0; frame < frames; frame++)
+        {
+            history[TAPS - 1 + frame] = input[frame * mChannels + channel];
+        }
+    }
+
+    while (mInputIndex < frames)
+    {
+        const float* phase = mPhases.data() + mPhase * TAPS;
+
+        for (unsigned int channel = 0; channel < mChannels; channel++)
+        {
+            *output++ = mKernels.dot(phase, mHistory[channel].data() + mInputIndex, TAPS);
+        }
+        written++;
+
+        mPhase += mDown;
+        mInputIndex += mPhase / mUp;
+        mPhase %= mUp;
+    }
+
+    mInputIndex -= frames;
+    for (std::vector<float>& history: mHistory)
+    {
+        std::copy(history.end() - (TAPS - 1), history.end(), history.begin());
+    }
+
+    return written;
+}
+
+void Resampler::reset()
+{
+    mInputIndex = 0;
+    mPhase = 0;
+
+    for (std::vector<float>& history: mHistory)
+    {
+        history.assign(TAPS - 1, 0.0f);
+    }
+}
+
+unsigned int Resampler::getLatencyUs() const
+{
+    // Half the prototype filter, at the upsampled rate
+    double center = (TAPS * mUp - 1) / 2.0;
+    return static_cast<unsigned int>(std::lround(center * 1e6 / (static_cast<double>(mInputRate) * mUp)));
+}
+
+void Resampler::computePhases()
+{
+    // Prototype low pass at the upsampled rate, in cycles per sample
+    size_t length = TAPS * mUp;
+    double center = (length - 1) / 2.0;
+    double cutoff = rolloff * std::min(mInputRate, mOutputRate) / (2.0 * mInputRate * mUp);
+    double windowScale = besselI0(kaiserBeta);
+
+    mPhases.resize(length);
+
+    for (unsigned int phase = 0; phase < mUp; phase++)
+    {
+        float* coefficients = mPhases.data() + phase * TAPS;
+        double sum = 0.0;
+
+        // Tap k of the phase weighs the input frame TAPS - 1 - k frames
+        // before the newest, sample k * mUp + phase of the prototype
+        for (size_t tap = 0; tap < TAPS; tap++)
+        {
+            double x = ((TAPS - 1 - tap) * mUp + phase) - center;
+            double ratio = x / center;
+            double window = besselI0(kaiserBeta * std::sqrt(std::max(0.0, 1.0 - ratio * ratio))) / windowScale;
+            double sinc = (x == 0.0) ? 1.0 : std::sin(2.0 * M_PI * cutoff * x) / (2.0 * M_PI * cutoff * x);
+            double value = 2.0 * cutoff * sinc * window;
+
+            coefficients[tap] = static_cast<float>(value);
+            sum += value;
+        }
+
+        // Each phase is normalized to unity gain, so that a constant input
+        // stays constant whatever the phase
+        for (size_t tap = 0; tap < TAPS; tap++)
+        {
+            coefficients[tap] = static_cast<float>(coefficients[tap] / sum);
+        }
+    }
+}
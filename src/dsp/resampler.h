@@ -0,0 +1,140 @@
+// Copyright (c) 2018 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+
+/**
+ * @file resampler.h
+ *
+ * @brief Streaming polyphase sample rate converter
+ *
+ */
+#ifndef RESAMPLER_H
+#define RESAMPLER_H
+
+#include <cstddef>
+#include <vector>
+
+/**
+ * One implementation of the loop resampling spends its time in, the dot
+ * product of a filter phase with the input frames it covers.
+ */
+struct ResampleKernels
+{
+    const char* name;
+
+    /**
+     * Sum of coefficients[i] * samples[i] for count values.
+     */
+    float (*dot)(const float* coefficients, const float* samples, size_t count);
+};
+
+/**
+ * Kernels this CPU runs, from the portable scalar ones to the fastest.
+ */
+const std::vector<const ResampleKernels*>& getSupportedResampleKernels();
+
+/**
+ * Converts interleaved float frames between two rates whose ratio reduces
+ * to at most MAX_PHASES output frames per input frames, which covers any
+ * pair of 44.1, 48 and 96 kHz. The input is upsampled, low pass filtered
+ * and decimated in one step: each output frame is one of the phases of a
+ * windowed sinc filter applied to the last TAPS input frames. The phases
+ * are computed once, and the filter history carries across process()
+ * calls so that a stream may be fed in blocks of any size.
+ */
+class Resampler
+{
+public:
+    // Input frames each output frame depends on
+    static const size_t TAPS = 64;
+    static const unsigned int MAX_PHASES = 512;
+
+    static bool isSupported(unsigned int inputRate, unsigned int outputRate);
+
+    /**
+     * The rates must be supported, see isSupported().
+     */
+    Resampler(unsigned int inputRate, unsigned int outputRate, unsigned int channels);
+
+    // With given kernels rather than the fastest, for benchmarks
+    Resampler(unsigned int inputRate, unsigned int outputRate, unsigned int channels,
+              const ResampleKernels& kernels);
+
+    Resampler(const Resampler &) = delete;
+    Resampler &operator=(const Resampler &) = delete;
+
+    /**
+     * Most output frames process() may return for inputFrames.
+     */
+    size_t getMaxOutputFrames(size_t inputFrames) const;
+
+    /**
+     * Convert frames of input into output, sized for
+     * getMaxOutputFrames(frames), and return how many were written.
+     */
+    size_t process(const float* input, size_t frames, float* output);
+
+    /**
+     * Back to silence, as after construction.
+     */
+    void reset();
+
+    unsigned int getInputRate() const
+    {
+        return mInputRate;
+    }
+
+    unsigned int getOutputRate() const
+    {
+        return mOutputRate;
+    }
+
+    /**
+     * Delay of the filter, the time the output lags the input by.
+     */
+    unsigned int getLatencyUs() const;
+
+    const ResampleKernels& getKernels() const
+    {
+        return mKernels;
+    }
+
+private:
+    void computePhases();
+
+    const ResampleKernels& mKernels;
+    unsigned int mInputRate;
+    unsigned int mOutputRate;
+    unsigned int mChannels;
+
+    // Output frames per input frames, as the smallest integers
+    unsigned int mUp;
+    unsigned int mDown;
+
+    // TAPS coefficients per phase, in input order
+    std::vector<float> mPhases;
+
+    // Position of the next output frame, as the last input frame it
+    // covers relative to the next block, and the phase between that
+    // frame and the following one
+    size_t mInputIndex = 0;
+    unsigned int mPhase = 0;
+
+    // Per channel, the last TAPS - 1 input frames followed by the block
+    // being converted
+    std::vector<std::vector<float>> mHistory;
+};
+#endif
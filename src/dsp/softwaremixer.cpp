@@ -0,0 +1,345 @@
+// Copyright (c) 2018 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+
+#include <algorithm>
+#include <chrono>
+#include "logging.h"
+#include "softwaremixer.h"
+
+// Periods mixed at once when the thread fell behind, the rest are skipped
+static const uint64_t maxCatchUpPeriods = 4;
+
+SoftwareMixer::SoftwareMixer(std::unique_ptr<PcmSink> sink, const MixerFormat& format)
+        : mKernels(getMixKernels())
+        , mSink(std::move(sink))
+        , mFormat(format)
+        , mAccumulator(format.periodFrames * format.channels)
+        , mOutput(format.periodFrames * format.channels)
+{
+    mEqualizer.prepare(mFormat.rate, mFormat.channels);
+
+    LOG_INFO(MSGID_SOFTWARE_MIXER, 0, "Software mixer using %s kernels, writing to the %s sink",
+             mKernels.name, mSink->getName());
+}
+
+SoftwareMixer::~SoftwareMixer()
+{
+    stop();
+}
+
+void SoftwareMixer::start()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    if (mThread.joinable())
+    {
+        return;
+    }
+
+    mStopping = false;
+    mThread = std::thread(&SoftwareMixer::run, this);
+}
+
+void SoftwareMixer::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        if (!mThread.joinable())
+        {
+            return;
+        }
+
+        mStopping = true;
+    }
+
+    mWakeup.notify_all();
+    mThread.join();
+}
+
+int SoftwareMixer::addInput()
+{
+    std::unique_ptr<PcmRingBuffer> buffer = PcmRingBuffer::create(MAX_QUEUED_PERIODS * mFormat.periodFrames,
+                                                                  mFormat.channels);
+    if (!buffer)
+    {
+        return INVALID_INPUT;
+    }
+
+    int id;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        id = mNextInput++;
+        mInputs.push_back(Input{id, 1.0f, false, std::move(buffer)});
+    }
+
+    mWakeup.notify_all();
+    return id;
+}
+
+void SoftwareMixer::removeInput(int input)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    Input* found = findInput(input);
+    if (found)
+    {
+        mUnderruns += found->buffer->getUnderruns();
+        mOverruns += found->buffer->getOverruns();
+    }
+
+    mInputs.erase(std::remove_if(mInputs.begin(), mInputs.end(),
+                                 [input](const Input& candidate) { return candidate.id == input; }),
+                  mInputs.end());
+}
+
+void SoftwareMixer::setGain(int input, float gain)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    Input* found = findInput(input);
+    if (found)
+    {
+        found->gain = gain;
+    }
+}
+
+void SoftwareMixer::setMuted(int input, bool muted)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    Input* found = findInput(input);
+    if (found)
+    {
+        found->muted = muted;
+    }
+}
+
+void SoftwareMixer::setEqualizer(const Equalizer* equalizer)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    if (equalizer != mEqualizerSource)
+    {
+        mEqualizer.prepare(mFormat.rate, mFormat.channels);
+    }
+
+    mEqualizerSource = equalizer;
+
+    if (!equalizer)
+    {
+        mEqualizer.setPreset("flat");
+    }
+    else if ("custom" == equalizer->getPreset())
+    {
+        mEqualizer.setBands(equalizer->getBands());
+    }
+    else
+    {
+        mEqualizer.setPreset(equalizer->getPreset());
+    }
+}
+
+bool SoftwareMixer::setOutputRate(unsigned int rate)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    if (rate == getOutputRate())
+    {
+        return true;
+    }
+
+    if (rate == mFormat.rate)
+    {
+        mResampler.reset();
+        LOG_INFO(MSGID_SOFTWARE_MIXER, 0, "Software mix written at %u Hz", rate);
+        return true;
+    }
+
+    if (!Resampler::isSupported(mFormat.rate, rate))
+    {
+        LOG_WARNING(MSGID_SOFTWARE_MIXER, 0, "No conversion from %u to %u Hz, writing at %u Hz",
+                    mFormat.rate, rate, mFormat.rate);
+        mResampler.reset();
+        return false;
+    }
+
+    mResampler.reset(new Resampler(mFormat.rate, rate, mFormat.channels));
+
+    size_t maxFrames = mResampler->getMaxOutputFrames(mFormat.periodFrames);
+    mResampled.resize(maxFrames * mFormat.channels);
+    mOutput.resize(std::max(mOutput.size(), mResampled.size()));
+
+    LOG_INFO(MSGID_SOFTWARE_MIXER, 0, "Software mix resampled from %u to %u Hz by %s kernels, %u us latency",
+             mFormat.rate, rate, mResampler->getKernels().name, mResampler->getLatencyUs());
+    return true;
+}
+
+size_t SoftwareMixer::write(int input, const int16_t* samples, size_t frames)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    Input* found = findInput(input);
+    if (!found)
+    {
+        return 0;
+    }
+
+    return found->buffer->push(samples, frames);
+}
+
+PcmRingBuffer* SoftwareMixer::getInputBuffer(int input)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    Input* found = findInput(input);
+    return found ? found->buffer.get() : nullptr;
+}
+
+void SoftwareMixer::mixPeriod()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    mixLocked();
+}
+
+void SoftwareMixer::run()
+{
+    const std::chrono::nanoseconds period(static_cast<int64_t>(mFormat.periodFrames) * 1000000000 / mFormat.rate);
+
+    std::unique_lock<std::mutex> lock(mMutex);
+    auto start = std::chrono::steady_clock::now();
+    uint64_t periods = 0;
+
+    while (!mStopping)
+    {
+        // Idle without inputs, the first one restarts the clock
+        if (mInputs.empty())
+        {
+            mWakeup.wait(lock, [this]() { return mStopping || !mInputs.empty(); });
+            start = std::chrono::steady_clock::now();
+            periods = 0;
+            continue;
+        }
+
+        // Paced by the clock rather than by the wakeups, which drift
+        uint64_t due = (std::chrono::steady_clock::now() - start) / period;
+        if (due > periods + maxCatchUpPeriods)
+        {
+            periods = due - maxCatchUpPeriods;
+        }
+
+        for (; periods < due; periods++)
+        {
+            mixLocked();
+        }
+
+        mWakeup.wait_until(lock, start + period * static_cast<int64_t>(periods + 1));
+    }
+}
+
+void SoftwareMixer::mixLocked()
+{
+    auto start = std::chrono::steady_clock::now();
+
+    std::fill(mAccumulator.begin(), mAccumulator.end(), 0.0f);
+
+    for (Input& input: mInputs)
+    {
+        // Accumulated straight from the ring, in two parts when it wraps
+        PcmRingBuffer::ReadRegions regions;
+        size_t available = input.buffer->peek(mFormat.periodFrames, regions);
+
+        if (!input.muted && input.gain != 0.0f && available > 0)
+        {
+            mKernels.accumulate(mAccumulator.data(), regions.first, regions.firstFrames * mFormat.channels,
+                                input.gain);
+            mKernels.accumulate(mAccumulator.data() + regions.firstFrames * mFormat.channels, regions.second,
+                                regions.secondFrames * mFormat.channels, input.gain);
+        }
+        input.buffer->consume(available);
+    }
+
+    if (mEqualizerSource)
+    {
+        mEqualizer.process(mAccumulator.data(), mFormat.periodFrames);
+    }
+
+    const float* mixed = mAccumulator.data();
+    size_t frames = mFormat.periodFrames;
+
+    if (mResampler)
+    {
+        frames = mResampler->process(mAccumulator.data(), frames, mResampled.data());
+        mixed = mResampled.data();
+    }
+
+    mKernels.convert(mOutput.data(), mixed, frames * mFormat.channels);
+
+    mMixNs += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    mPeriods++;
+
+    if (!mSink->write(mOutput.data(), frames, mFormat.channels))
+    {
+        mSinkErrors++;
+    }
+}
+
+pbnjson::JValue SoftwareMixer::toJson() const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    pbnjson::JValue mixerObj = pbnjson::Object();
+    uint64_t frames = mPeriods * mFormat.periodFrames;
+    uint64_t underruns = mUnderruns;
+    uint64_t overruns = mOverruns;
+
+    for (const Input& input: mInputs)
+    {
+        underruns += input.buffer->getUnderruns();
+        overruns += input.buffer->getOverruns();
+    }
+
+    mixerObj.put("kernels", mKernels.name);
+    mixerObj.put("sink", mSink->getName());
+    mixerObj.put("equalizer", mEqualizerSource ? mEqualizer.getPreset() : std::string("none"));
+    mixerObj.put("outputRate", static_cast<int64_t>(getOutputRate()));
+    mixerObj.put("resampler", mResampler ? mResampler->getKernels().name : "none");
+    mixerObj.put("latencyUs", static_cast<int64_t>(getLatencyUs()));
+    mixerObj.put("inputs", static_cast<int64_t>(mInputs.size()));
+    mixerObj.put("periods", static_cast<int64_t>(mPeriods));
+    mixerObj.put("underruns", static_cast<int64_t>(underruns));
+    mixerObj.put("overruns", static_cast<int64_t>(overruns));
+    mixerObj.put("sinkErrors", static_cast<int64_t>(mSinkErrors));
+    mixerObj.put("nsPerFrame", frames ? static_cast<int64_t>(mMixNs / frames) : 0);
+
+    return mixerObj;
+}
+
+SoftwareMixer::Input* SoftwareMixer::findInput(int input)
+{
+    for (Input& candidate: mInputs)
+    {
+        if (candidate.id == input)
+        {
+            return &candidate;
+        }
+    }
+
+    return nullptr;
+}
@@ -0,0 +1,202 @@
+// Copyright (c) 2018 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+
+/**
+ * @file softwaremixer.h
+ *
+ * @brief Mixes PCM inputs in process instead of in the HAL mixer
+ *
+ */
+#ifndef SOFTWARE_MIXER_H
+#define SOFTWARE_MIXER_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <pbnjson.hpp>
+#include "equalizer.h"
+#include "mixkernels.h"
+#include "pcmringbuffer.h"
+#include "pcmsink.h"
+#include "resampler.h"
+
+/**
+ * Stream the software mixer produces, its inputs are expected in it too.
+ */
+struct MixerFormat
+{
+    unsigned int rate = 48000;
+    unsigned int channels = 2;
+    unsigned int periodFrames = 480;
+};
+
+/**
+ * Sums any number of inputs, each with its own gain, into one stream
+ * written to a PcmSink a period at a time. Between start() and stop() a
+ * thread of its own paces the periods by the clock and sleeps while there
+ * are no inputs, without it periods are mixed by calling mixPeriod(). An
+ * input short of a period is mixed with what it has, the rest is silence
+ * and counted as an underrun.
+ * The sum goes through a copy of the equalizer of the output the mix is
+ * routed to, if any, and is resampled to the native rate of that output
+ * if it differs from the mixer rate, before it is converted back to 16 bit.
+ * Each input is queued in a PcmRingBuffer, fed with write() on the main
+ * loop or pushed to directly by one producer thread, see getInputBuffer().
+ * Every other call is made on the main loop, and waits for a period being
+ * mixed to be written to the sink.
+ */
+class SoftwareMixer
+{
+public:
+    static const int INVALID_INPUT = -1;
+
+    // Frames an input may queue ahead of the mixer, in periods, rounded up
+    // to the power of two of the ring buffer
+    static const unsigned int MAX_QUEUED_PERIODS = 8;
+
+    explicit SoftwareMixer(std::unique_ptr<PcmSink> sink, const MixerFormat& format = MixerFormat());
+    ~SoftwareMixer();
+
+    SoftwareMixer(const SoftwareMixer &) = delete;
+    SoftwareMixer &operator=(const SoftwareMixer &) = delete;
+
+    /**
+     * Start and stop the mixing thread, the destructor stops it.
+     */
+    void start();
+    void stop();
+
+    /**
+     * INVALID_INPUT if its buffer cannot be allocated.
+     */
+    int addInput();
+    void removeInput(int input);
+
+    void setGain(int input, float gain);
+    void setMuted(int input, bool muted);
+
+    /**
+     * Equalizer whose settings are applied to the mix, nullptr for none.
+     * The mix goes through a copy, call again after changing the settings;
+     * switching to another equalizer starts its filters afresh.
+     */
+    void setEqualizer(const Equalizer* equalizer);
+
+    const Equalizer* getEqualizer() const
+    {
+        return mEqualizerSource;
+    }
+
+    /**
+     * Rate the sink runs at, a resampler is inserted when it differs from
+     * the mixer rate. False if the conversion is not supported, the mix
+     * is then written at the mixer rate.
+     */
+    bool setOutputRate(unsigned int rate);
+
+    unsigned int getOutputRate() const
+    {
+        return mResampler ? mResampler->getOutputRate() : mFormat.rate;
+    }
+
+    // Delay the resampler adds, 0 without one
+    unsigned int getLatencyUs() const
+    {
+        return mResampler ? mResampler->getLatencyUs() : 0;
+    }
+
+    /**
+     * Queue frames of an input, returns how many fit.
+     */
+    size_t write(int input, const int16_t* samples, size_t frames);
+
+    /**
+     * Buffer of an input for a producer thread to push to, the mixing
+     * thread is its consumer. It stays valid until removeInput(), which
+     * must not be called while the producer runs. nullptr for an unknown
+     * input.
+     */
+    PcmRingBuffer* getInputBuffer(int input);
+
+    /**
+     * Mix one period into the sink, for callers that do not start() the
+     * mixing thread.
+     */
+    void mixPeriod();
+
+    size_t getInputCount() const
+    {
+        return mInputs.size();
+    }
+
+    const MixerFormat& getFormat() const
+    {
+        return mFormat;
+    }
+
+    const MixKernels& getKernels() const
+    {
+        return mKernels;
+    }
+
+    pbnjson::JValue toJson() const;
+
+private:
+    struct Input
+    {
+        int id;
+        float gain;
+        bool muted;
+        std::unique_ptr<PcmRingBuffer> buffer;
+    };
+
+    void run();
+    void mixLocked();
+    Input* findInput(int input);
+
+    const MixKernels& mKernels;
+    std::unique_ptr<PcmSink> mSink;
+    MixerFormat mFormat;
+
+    // Guards everything below against the mixing thread
+    mutable std::mutex mMutex;
+    std::condition_variable mWakeup;
+    std::thread mThread;
+    bool mStopping = false;
+
+    std::vector<Input> mInputs;
+    // The equalizer the settings come from, never used by the thread
+    const Equalizer* mEqualizerSource = nullptr;
+    Equalizer mEqualizer;
+    std::unique_ptr<Resampler> mResampler;
+    std::vector<float> mAccumulator;
+    std::vector<float> mResampled;
+    std::vector<int16_t> mOutput;
+    int mNextInput = 0;
+
+    uint64_t mPeriods = 0;
+    // Of the inputs removed, those of the others are in their buffers
+    uint64_t mUnderruns = 0;
+    uint64_t mOverruns = 0;
+    uint64_t mSinkErrors = 0;
+    uint64_t mMixNs = 0;
+};
+#endif
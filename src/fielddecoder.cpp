@@ -0,0 +1,267 @@
+// Copyright (c) 2018 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+
+#include <climits>
+#include <cstring>
+#include "fielddecoder.h"
+
+namespace LSUtils {
+
+bool FieldDecoder::decode(const char *payload)
+{
+    if (mOverflow || !payload)
+    {
+        return false;
+    }
+
+    const char *c = skipSpaces(payload);
+    if ('{' != *c)
+    {
+        return false;
+    }
+
+    c = skipSpaces(c + 1);
+
+    if ('}' == *c)
+    {
+        c++;
+    }
+    else
+    {
+        for (;;)
+        {
+            // Keys are plain names, an escape sends the payload to the schema path
+            if ('"' != *c)
+            {
+                return false;
+            }
+
+            const char *name = c + 1;
+            const char *nameEnd = strpbrk(name, "\"\\");
+            if (!nameEnd || '"' != *nameEnd)
+            {
+                return false;
+            }
+
+            Field *field = findField(name, nameEnd - name);
+            if (!field || field->seen)
+            {
+                return false;
+            }
+            field->seen = true;
+
+            c = skipSpaces(nameEnd + 1);
+            if (':' != *c)
+            {
+                return false;
+            }
+            c = skipSpaces(c + 1);
+
+            switch (field->type)
+            {
+                case STRING:
+                    c = decodeString(c, *static_cast<std::string *>(field->target));
+                    break;
+                case INTEGER:
+                    c = decodeInteger(c, *static_cast<int *>(field->target));
+                    break;
+                case BOOLEAN:
+                    c = decodeBoolean(c, *static_cast<bool *>(field->target));
+                    break;
+            }
+
+            if (!c)
+            {
+                return false;
+            }
+
+            c = skipSpaces(c);
+            if ('}' == *c)
+            {
+                c++;
+                break;
+            }
+            if (',' != *c)
+            {
+                return false;
+            }
+            c = skipSpaces(c + 1);
+        }
+    }
+
+    if ('\0' != *skipSpaces(c))
+    {
+        return false;
+    }
+
+    for (int i = 0; i < mCount; i++)
+    {
+        if (mFields[i].required && !mFields[i].seen)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void FieldDecoder::decode(const pbnjson::JValue &object)
+{
+    for (int i = 0; i < mCount; i++)
+    {
+        const Field &field = mFields[i];
+
+        if (!object.hasKey(field.name))
+        {
+            continue;
+        }
+
+        switch (field.type)
+        {
+            case STRING:
+                *static_cast<std::string *>(field.target) = object[field.name].asString();
+                break;
+            case INTEGER:
+                *static_cast<int *>(field.target) = object[field.name].asNumber<int>();
+                break;
+            case BOOLEAN:
+                *static_cast<bool *>(field.target) = object[field.name].asBool();
+                break;
+        }
+    }
+}
+
+FieldDecoder::Field *FieldDecoder::findField(const char *name, size_t length)
+{
+    for (int i = 0; i < mCount; i++)
+    {
+        if (0 == strncmp(mFields[i].name, name, length) && '\0' == mFields[i].name[length])
+        {
+            return &mFields[i];
+        }
+    }
+
+    return nullptr;
+}
+
+const char *FieldDecoder::skipSpaces(const char *c)
+{
+    while (' ' == *c || '\t' == *c || '\n' == *c || '\r' == *c)
+    {
+        c++;
+    }
+
+    return c;
+}
+
+const char *FieldDecoder::decodeString(const char *c, std::string &value)
+{
+    if ('"' != *c)
+    {
+        return nullptr;
+    }
+
+    value.clear();
+
+    for (c++; '"' != *c; c++)
+    {
+        if ('\0' == *c || static_cast<unsigned char>(*c) < 0x20)
+        {
+            return nullptr;
+        }
+
+        if ('\\' != *c)
+        {
+            value += *c;
+            continue;
+        }
+
+        switch (*++c)
+        {
+            case '"':  value += '"'; break;
+            case '\\': value += '\\'; break;
+            case '/':  value += '/'; break;
+            case 'b':  value += '\b'; break;
+            case 'f':  value += '\f'; break;
+            case 'n':  value += '\n'; break;
+            case 'r':  value += '\r'; break;
+            case 't':  value += '\t'; break;
+            default:   return nullptr;     // \u and invalid escapes
+        }
+    }
+
+    return c + 1;
+}
+
+const char *FieldDecoder::decodeInteger(const char *c, int &value)
+{
+    bool negative = ('-' == *c);
+    long long result = 0;
+
+    if (negative)
+    {
+        c++;
+    }
+
+    // JSON has no leading zeros, fractions and exponents go to the schema path
+    if (*c < '0' || *c > '9' || ('0' == *c && c[1] >= '0' && c[1] <= '9'))
+    {
+        return nullptr;
+    }
+
+    for (; *c >= '0' && *c <= '9'; c++)
+    {
+        result = result * 10 + (*c - '0');
+        if (result > static_cast<long long>(INT_MAX) + 1)
+        {
+            return nullptr;
+        }
+    }
+
+    if ('.' == *c || 'e' == *c || 'E' == *c)
+    {
+        return nullptr;
+    }
+
+    result = negative ? -result : result;
+    if (result > INT_MAX)
+    {
+        return nullptr;
+    }
+
+    value = static_cast<int>(result);
+    return c;
+}
+
+const char *FieldDecoder::decodeBoolean(const char *c, bool &value)
+{
+    if (0 == strncmp(c, "true", 4))
+    {
+        value = true;
+        return c + 4;
+    }
+
+    if (0 == strncmp(c, "false", 5))
+    {
+        value = false;
+        return c + 5;
+    }
+
+    return nullptr;
+}
+
+} // namespace LSUtils
@@ -0,0 +1,119 @@
+// Copyright (c) 2018 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+
+/**
+ * @file fielddecoder.h
+ *
+ * @brief Decodes flat request payloads straight into variables
+ *
+ */
+#ifndef FIELD_DECODER_H
+#define FIELD_DECODER_H
+
+#include <string>
+#include <pbnjson.hpp>
+
+namespace LSUtils {
+
+/**
+ * Single pass decoder of the small requests made of a few scalar fields,
+ * e.g. {"soundOutput":"alsa","volume":42}. Fields are bound to variables
+ * of the handler, then decode() checks the payload against them and
+ * stores the values without building a DOM:
+ *
+ *     FieldDecoder fields;
+ *     fields.string("soundOutput", params.soundOutput).integer("volume", params.volume);
+ *
+ * The payload is accepted only if it is an object holding nothing but
+ * the bound fields, with the bound types, and every required one. Anything
+ * else, including valid JSON the decoder does not handle such as \u
+ * escapes, makes decode() fail; the caller then takes the schema path,
+ * which decides and explains. See parsePayload() in utils.h.
+ */
+class FieldDecoder
+{
+public:
+    static const int MAX_FIELDS = 4;
+
+    FieldDecoder &string(const char *name, std::string &target, bool required = true)
+    {
+        return bind(name, STRING, &target, required);
+    }
+
+    FieldDecoder &integer(const char *name, int &target, bool required = true)
+    {
+        return bind(name, INTEGER, &target, required);
+    }
+
+    FieldDecoder &boolean(const char *name, bool &target, bool required = true)
+    {
+        return bind(name, BOOLEAN, &target, required);
+    }
+
+    /**
+     * Decode a payload, false if it is not exactly what the fields describe.
+     * Targets may be partly written on failure.
+     */
+    bool decode(const char *payload);
+
+    /**
+     * Fill the targets from a request the schema path already validated,
+     * skipping fields it does not have.
+     */
+    void decode(const pbnjson::JValue &object);
+
+private:
+    enum Type
+    {
+        STRING,
+        INTEGER,
+        BOOLEAN
+    };
+
+    struct Field
+    {
+        const char *name;
+        Type type;
+        void *target;
+        bool required;
+        bool seen;
+    };
+
+    FieldDecoder &bind(const char *name, Type type, void *target, bool required)
+    {
+        if (mCount < MAX_FIELDS) {
+            mFields[mCount++] = Field{name, type, target, required, false};
+        } else {
+            mOverflow = true;
+        }
+        return *this;
+    }
+
+    Field *findField(const char *name, size_t length);
+
+    static const char *skipSpaces(const char *c);
+    static const char *decodeString(const char *c, std::string &value);
+    static const char *decodeInteger(const char *c, int &value);
+    static const char *decodeBoolean(const char *c, bool &value);
+
+    Field mFields[MAX_FIELDS];
+    int mCount = 0;
+    bool mOverflow = false;
+};
+
+} // namespace LSUtils
+#endif // FIELD_DECODER_H
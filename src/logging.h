@@ -73,6 +73,7 @@ extern PmLogContext logContext;
 #define MSGID_HAL_INIT_ERROR                   "HAL_INIT_ERROR"
 #define MSGID_HAL_DEINIT_ERROR                 "HAL_DEINIT_ERROR"
 #define MSGID_TERMINATING                      "TERMINATING"
+#define MSGID_STARTUP_TIMING                   "STARTUP_TIMING"
 #define MSGID_SIGNAL_HANDLER_ERROR             "SIGNAL_HANDLER_ERROR"
 #define MSGID_UNKNOWN_SOURCE_NAME              "UNKNOWN_SOURCE_NAME"
 
@@ -80,10 +81,16 @@ extern PmLogContext logContext;
 #define MSGID_JSON_PARSE_ERROR                 "JSON_PARSE_ERROR"
 #define MSGID_INVALID_PARAMETERS_ERR           "INVALID_PARAMETERS"
 #define MSGID_SINK_SETUP_ERROR                 "SINK_SETUP_ERROR"
+#define MSGID_SOFTWARE_MIXER                   "SOFTWARE_MIXER"
+#define MSGID_RING_BUFFER_ERROR                "RING_BUFFER_ERROR"
 
 //Config
 #define MSGID_CONFIG_EQUALIZER_ERROR           "CONFIG_EQUALIZER_ERROR"
 #define MSGID_CONFIG_EQUALIZER_VALUES_ERROR    "CONFIG_EQUALIZER_VALUES_ERROR"
 #define MSGID_CONFIG_VOLUME_ERROR              "CONFIG_VOLUME_ERROR"
 
+//State
+#define MSGID_STATE_LOAD_ERROR                 "STATE_LOAD_ERROR"
+#define MSGID_STATE_SAVE_ERROR                 "STATE_SAVE_ERROR"
+
 #endif // LOGGING_H
@@ -14,13 +14,19 @@
 //
 // SPDX-License-Identifier: Apache-2.0
 
+#include <algorithm>
 #include <string>
+#include <vector>
 #include <glib.h>
 #include <sys/signalfd.h>
 
 #include "logging.h"
 #include "audio/volumeservice.h"
 #include "audio/audioservice.h"
+#include "audio/halexecutor.h"
+#include "dsp/softwaremixer.h"
+#include "ratelimiter.h"
+#include "statestore.h"
 #include <umiclient.h>
 
 
@@ -29,18 +35,68 @@ PmLogContext logContext;
 static const char* const logContextName = "audiooutputd";
 static const char* const logPrefix= "[audiooutputd] ";
 static const std::string busName = "com.webos.service.audiooutput";
+static const char* const defaultStateFile = "/var/lib/audiooutputd/state.json";
+static const char* const defaultOutputsFile = "/etc/audiooutputd/outputs.json";
+
+// Budgets of the methods a client may call in a loop, --rate-limit overrides them
+static const char* const defaultRateLimits[] = {
+        "/audio/volume/up=50/100",
+        "/audio/volume/down=50/100",
+        "/audio/volume/set=50/100",
+        "/audio/volume/muteSoundOut=50/100",
+};
 
 static gboolean option_version = FALSE;
+static gint option_volume_window = 30;
+static gint option_hal_workers = -1;
+static gchar *option_state_file = nullptr;
+static gchar *option_outputs_file = nullptr;
+static gchar **option_rate_limits = nullptr;
+static gchar *option_mixer_sink = nullptr;
 static GMainLoop *mainLoop = nullptr;
 static bool terminated = false;
+static bool halFailed = false;
+static gint64 startTime = 0;
 
 static GOptionEntry options[] = {
         { "version", 'v', 0, G_OPTION_ARG_NONE, &option_version,
                 "Show version information and exit", ""},
+        { "volume-window", 'w', 0, G_OPTION_ARG_INT, &option_volume_window,
+                "Merge volume up/down requests arriving within MS into one HAL write (0 disables)", "MS"},
+        { "hal-workers", 'j', 0, G_OPTION_ARG_INT, &option_hal_workers,
+                "Number of threads running HAL calls (0 runs them on the main loop, default one per sound output)", "N"},
+        { "state-file", 's', 0, G_OPTION_ARG_FILENAME, &option_state_file,
+                "File keeping volume, mute and connections across restarts (empty to disable)", "FILE"},
+        { "outputs-config", 'o', 0, G_OPTION_ARG_FILENAME, &option_outputs_file,
+                "File listing the sound outputs and their volume controllers", "FILE"},
+        { "rate-limit", 'r', 0, G_OPTION_ARG_STRING_ARRAY, &option_rate_limits,
+                "Allow each client RATE calls per second of METHOD, BURST at once (RATE 0 removes the limit)",
+                "/category/METHOD=RATE[/BURST]"},
+        { "mixer-sink", 'm', 0, G_OPTION_ARG_FILENAME, &option_mixer_sink,
+                "Raw PCM file the software mixer writes to, null (default) drops its output", "FILE"},
         { NULL, ' ', 0, G_OPTION_ARG_NONE, NULL, NULL, NULL },
 };
 
 
+// Milliseconds since the service started, for the startup phase logs
+static long startupElapsedMs()
+{
+    return static_cast<long>((g_get_monotonic_time() - startTime) / 1000);
+}
+
+static void halInitialized(UMI_ERROR result)
+{
+    if (UMI_ERROR_NONE != result)
+    {
+        LOG_ERROR(MSGID_HAL_INIT_ERROR, 0, "UMI init failed!stop AudiooutputD Service.");
+        halFailed = true;
+        g_main_loop_quit(mainLoop);
+        return;
+    }
+
+    LOG_INFO(MSGID_STARTUP_TIMING, 0, "HAL initialized after %ld ms", startupElapsedMs());
+}
+
 static void lunaBusDisconnected(LSHandle *sh, void *user_data)
 {
     terminated = true;
@@ -145,6 +201,8 @@ int main(int argc, char **argv)
     GOptionContext *context;
     GError *err = NULL;
 
+    startTime = g_get_monotonic_time();
+
     context = g_option_context_new(NULL);
     g_option_context_add_main_entries(context, options, NULL);
 
@@ -159,6 +217,33 @@ int main(int argc, char **argv)
 
     g_option_context_free(context);
 
+    if (option_volume_window < 0)
+    {
+        std::cerr << logPrefix << "Invalid volume window " << option_volume_window << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    if (option_hal_workers < -1)
+    {
+        std::cerr << logPrefix << "Invalid number of HAL workers " << option_hal_workers << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    for (const char* rateLimit : defaultRateLimits)
+    {
+        RateLimiter::instance().setBudget(rateLimit);
+    }
+
+    for (gchar** rateLimit = option_rate_limits; rateLimit && *rateLimit; rateLimit++)
+    {
+        if (!RateLimiter::instance().setBudget(*rateLimit))
+        {
+            std::cerr << logPrefix << "Invalid rate limit " << *rateLimit << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+    g_strfreev(option_rate_limits);
+
     PmLogErr error = PmLogGetContext(logContextName, &logContext);
     if (error != kPmLogErr_None)
     {
@@ -173,21 +258,51 @@ int main(int argc, char **argv)
     umiClient* umi = umiClient::getInstance();
     try
     {
-        if( (nullptr == umi) || !umi->initialize())
+        if (nullptr == umi)
         {
             LOG_ERROR(MSGID_HAL_INIT_ERROR, 0, "UMI init failed!stop AudiooutputD Service.");
             throw("stop AudiooutputD Service");
         }
 
+        std::vector<OutputConfig> outputs =
+            OutputRegistry::loadConfig(option_outputs_file ? option_outputs_file : defaultOutputsFile);
+
+        // Group volume and mute changes run the HAL calls of every output
+        // at once when each has a worker
+        unsigned int halWorkers = (option_hal_workers >= 0) ? option_hal_workers
+                                                            : std::max<size_t>(outputs.size(), 1);
+
+        // Outlives the services, their destructors still queue HAL calls
+        HalExecutor halExecutor(halWorkers);
+
+        // UMI probes the hardware while the service joins the bus. HAL
+        // calls made by early requests are held until it is done.
+        halExecutor.initialize("initialize",
+                               [umi]() { return umi->initialize() ? UMI_ERROR_NONE : UMI_ERROR_FAIL; },
+                               halInitialized);
+
         LS::Handle audiooutputService{busName.c_str()};
+        LOG_INFO(MSGID_STARTUP_TIMING, 0, "Registered on the bus after %ld ms", startupElapsedMs());
+
+        // Outlives the services, they save their last state on destruction
+        StateStore stateStore(option_state_file ? option_state_file : defaultStateFile);
+
+        // Connections made with the software mixer feed it, it mixes on a
+        // thread of its own
+        SoftwareMixer mixer(PcmSink::create(option_mixer_sink ? option_mixer_sink : ""));
+        mixer.start();
 
         // Initialize categories
-        VolumeService audioVolume(audiooutputService,umi);
-        AudioService audio(audiooutputService, audioVolume,umi);
+        VolumeService audioVolume(audiooutputService,umi, halExecutor, stateStore, outputs, option_volume_window);
+        AudioService audio(audiooutputService, audioVolume,umi, halExecutor, stateStore, mixer);
 
         audiooutputService.attachToLoop(mainLoop);
         audiooutputService.setDisconnectHandler(lunaBusDisconnected, nullptr);
-        g_main_loop_run(mainLoop);
+        LOG_INFO(MSGID_STARTUP_TIMING, 0, "Serving requests after %ld ms", startupElapsedMs());
+
+        // Without HAL workers the initialization already ran
+        if (!halFailed)
+            g_main_loop_run(mainLoop);
     }
     catch (const std::exception& e)
     {
@@ -206,6 +321,14 @@ int main(int argc, char **argv)
 
     g_source_remove(signal);
     g_main_loop_unref(mainLoop);
+    g_free(option_state_file);
+    g_free(option_outputs_file);
+    g_free(option_mixer_sink);
+
+    if (halFailed)
+    {
+        exit(EXIT_FAILURE);
+    }
 
     if( (nullptr == umi) || !umi->deinitialize())
     {
@@ -0,0 +1,176 @@
+// Copyright (c) 2018 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+
+#include <algorithm>
+#include <cstdlib>
+#include "ratelimiter.h"
+
+RateLimiter& RateLimiter::instance()
+{
+    static RateLimiter limiter;
+    return limiter;
+}
+
+void RateLimiter::setBudget(const std::string& method, const Budget& budget)
+{
+    mMethods.erase(method);
+
+    if (budget.rate > 0)
+    {
+        mMethods.emplace(method, Method(Budget{budget.rate, std::max(budget.burst, 1.0)}));
+    }
+}
+
+bool RateLimiter::setBudget(const std::string& spec)
+{
+    size_t equals = spec.find('=');
+    if (equals == std::string::npos || 0 == equals)
+    {
+        return false;
+    }
+
+    const char* rateText = spec.c_str() + equals + 1;
+    char* end = nullptr;
+    Budget budget;
+
+    budget.rate = strtod(rateText, &end);
+    budget.burst = budget.rate;
+    if (end == rateText || budget.rate < 0)
+    {
+        return false;
+    }
+
+    if ('/' == *end)
+    {
+        const char* burstText = end + 1;
+        budget.burst = strtod(burstText, &end);
+        if (end == burstText || budget.burst < 0)
+        {
+            return false;
+        }
+    }
+
+    if ('\0' != *end)
+    {
+        return false;
+    }
+
+    setBudget(spec.substr(0, equals), budget);
+    return true;
+}
+
+RateLimiter::Method* RateLimiter::find(LSMessage* message)
+{
+    auto iter = mMethods.find(std::string(LSMessageGetCategory(message)) + "/" + LSMessageGetMethod(message));
+    if (iter == mMethods.end())
+    {
+        return nullptr;
+    }
+
+    return &iter->second;
+}
+
+bool RateLimiter::allow(Method& method, LSMessage* message)
+{
+    gint64 now = g_get_monotonic_time();
+    std::string sender = getSender(message);
+
+    auto iter = method.mBuckets.find(sender);
+    if (iter == method.mBuckets.end())
+    {
+        // Forget senders whose bucket has refilled, they are idle
+        if (method.mBuckets.size() >= MAX_BUCKETS)
+        {
+            for (auto bucket = method.mBuckets.begin(); bucket != method.mBuckets.end();)
+            {
+                double idleSeconds = (now - bucket->second.refillTime) / 1e6;
+                if (bucket->second.tokens + idleSeconds * method.mBudget.rate >= method.mBudget.burst)
+                    bucket = method.mBuckets.erase(bucket);
+                else
+                    ++bucket;
+            }
+        }
+
+        iter = method.mBuckets.emplace(sender, Method::Bucket{method.mBudget.burst, now, 0}).first;
+    }
+
+    Method::Bucket& bucket = iter->second;
+
+    bucket.tokens = std::min(method.mBudget.burst,
+                             bucket.tokens + (now - bucket.refillTime) / 1e6 * method.mBudget.rate);
+    bucket.refillTime = now;
+
+    if (bucket.tokens < 1.0)
+    {
+        bucket.throttled++;
+        method.mThrottled++;
+        return false;
+    }
+
+    bucket.tokens -= 1.0;
+    return true;
+}
+
+pbnjson::JValue RateLimiter::toJson() const
+{
+    pbnjson::JArray methods;
+
+    for (auto& method : mMethods)
+    {
+        pbnjson::JValue methodObj = pbnjson::Object();
+        pbnjson::JValue senders = pbnjson::Object();
+
+        for (auto& bucket : method.second.mBuckets)
+        {
+            if (bucket.second.throttled)
+                senders.put(bucket.first, static_cast<int64_t>(bucket.second.throttled));
+        }
+
+        methodObj.put("name", method.first);
+        methodObj.put("rate", method.second.mBudget.rate);
+        methodObj.put("burst", method.second.mBudget.burst);
+        methodObj.put("throttled", static_cast<int64_t>(method.second.mThrottled));
+        methodObj.put("throttledSenders", senders);
+        methods.append(methodObj);
+    }
+
+    return methods;
+}
+
+void RateLimiter::reset()
+{
+    for (auto& method : mMethods)
+    {
+        method.second.mThrottled = 0;
+        for (auto& bucket : method.second.mBuckets)
+        {
+            bucket.second.throttled = 0;
+        }
+    }
+}
+
+std::string RateLimiter::getSender(LSMessage* message)
+{
+    const char* sender = LSMessageGetApplicationID(message);
+
+    if (!sender || !*sender)
+        sender = LSMessageGetSenderServiceName(message);
+    if (!sender || !*sender)
+        sender = LSMessageGetSender(message);
+
+    return sender ? sender : "";
+}
@@ -0,0 +1,111 @@
+// Copyright (c) 2018 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+
+/**
+ * @file ratelimiter.h
+ *
+ * @brief Per sender request budgets of the Luna methods
+ *
+ */
+#ifndef RATE_LIMITER_H
+#define RATE_LIMITER_H
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <glib.h>
+#include <pbnjson.hpp>
+#include <luna-service2/lunaservice.h>
+
+/**
+ * Token buckets limiting how often a client may call a Luna method.
+ * Every sender of a limited method has its own bucket, so a client going
+ * over its budget does not eat into the budget of the others. Senders
+ * are told apart by application id, service name or bus address, the
+ * first one the message has. Main loop only.
+ */
+class RateLimiter
+{
+public:
+    struct Budget
+    {
+        double rate;    // requests per second, refilling the bucket
+        double burst;   // bucket size, requests allowed at once
+    };
+
+    /**
+     * Limits and throttled calls of a method.
+     */
+    class Method
+    {
+    public:
+        explicit Method(const Budget& budget) : mBudget(budget) {}
+
+    private:
+        friend class RateLimiter;
+
+        struct Bucket
+        {
+            double tokens;
+            gint64 refillTime;
+            uint64_t throttled;
+        };
+
+        Budget mBudget;
+        uint64_t mThrottled = 0;
+        std::unordered_map<std::string, Bucket> mBuckets;
+    };
+
+    static RateLimiter& instance();
+
+    /**
+     * Limit the method, named "/category/method" as in the stats. A rate
+     * of 0 removes the limit. Call before the methods are registered.
+     */
+    void setBudget(const std::string& method, const Budget& budget);
+
+    /**
+     * Same, from a "/category/method=RATE[/BURST]" command line spec.
+     * BURST defaults to RATE. False if the spec is invalid.
+     */
+    bool setBudget(const std::string& spec);
+
+    /**
+     * Limits of the method the message was sent to, nullptr if unlimited.
+     */
+    Method* find(LSMessage* message);
+
+    /**
+     * Take a token from the bucket of the sender.
+     * @return false if the sender is over budget.
+     */
+    bool allow(Method& method, LSMessage* message);
+
+    pbnjson::JValue toJson() const;
+    void reset();
+
+private:
+    // Buckets kept per method before idle ones are dropped
+    static const size_t MAX_BUCKETS = 256;
+
+    RateLimiter() = default;
+
+    static std::string getSender(LSMessage* message);
+
+    std::unordered_map<std::string, Method> mMethods;
+};
+#endif
@@ -0,0 +1,152 @@
+// Copyright (c) 2018 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+
+/**
+ * @file responsewriter.h
+ *
+ * @brief Serializes fixed shape Luna replies without building a JSON DOM
+ *
+ */
+#ifndef RESPONSE_WRITER_H
+#define RESPONSE_WRITER_H
+
+#include <cstdio>
+#include <string>
+
+namespace LSUtils {
+
+/**
+ * Writes a JSON object of strings, integers, booleans and nested objects
+ * straight into a buffer kept from one reply to the next, so a reply
+ * costs no allocation once the buffer has grown to size:
+ *
+ *     postToClient(request, ResponseWriter::instance().begin(true)
+ *                               .add("soundOutput", name).add("volume", volume).end());
+ *
+ * The instance() writer belongs to the main loop; a reply has to be sent
+ * before the next one is begun.
+ */
+class ResponseWriter
+{
+public:
+    static ResponseWriter &instance()
+    {
+        static ResponseWriter writer;
+        return writer;
+    }
+
+    ResponseWriter &begin(bool returnValue)
+    {
+        mBuffer.clear();
+        mBuffer += '{';
+        mFirst = true;
+        return add("returnValue", returnValue);
+    }
+
+    ResponseWriter &add(const char *key, const char *value)
+    {
+        appendKey(key);
+        appendString(value);
+        return *this;
+    }
+
+    ResponseWriter &add(const char *key, const std::string &value)
+    {
+        return add(key, value.c_str());
+    }
+
+    ResponseWriter &add(const char *key, int value)
+    {
+        char digits[16];
+        int length = snprintf(digits, sizeof(digits), "%d", value);
+
+        appendKey(key);
+        mBuffer.append(digits, length);
+        return *this;
+    }
+
+    ResponseWriter &add(const char *key, bool value)
+    {
+        appendKey(key);
+        mBuffer += value ? "true" : "false";
+        return *this;
+    }
+
+    ResponseWriter &beginObject(const char *key)
+    {
+        appendKey(key);
+        mBuffer += '{';
+        mFirst = true;
+        return *this;
+    }
+
+    ResponseWriter &endObject()
+    {
+        mBuffer += '}';
+        mFirst = false;
+        return *this;
+    }
+
+    /**
+     * Close the reply. The payload stays valid until the next begin().
+     */
+    const std::string &end()
+    {
+        mBuffer += '}';
+        return mBuffer;
+    }
+
+private:
+    void appendKey(const char *key)
+    {
+        if (!mFirst) {
+            mBuffer += ',';
+        }
+        mFirst = false;
+        appendString(key);
+        mBuffer += ':';
+    }
+
+    void appendString(const char *value)
+    {
+        mBuffer += '"';
+        for (const char *c = value; *c; c++) {
+            switch (*c) {
+                case '"':  mBuffer += "\\\""; break;
+                case '\\': mBuffer += "\\\\"; break;
+                case '\n': mBuffer += "\\n"; break;
+                case '\r': mBuffer += "\\r"; break;
+                case '\t': mBuffer += "\\t"; break;
+                default:
+                    if (static_cast<unsigned char>(*c) < 0x20) {
+                        char escaped[8];
+                        snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned char>(*c));
+                        mBuffer += escaped;
+                    } else {
+                        mBuffer += *c;
+                    }
+            }
+        }
+        mBuffer += '"';
+    }
+
+    std::string mBuffer;
+    bool mFirst = true;
+};
+
+} // namespace LSUtils
+#endif // RESPONSE_WRITER_H
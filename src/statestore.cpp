@@ -0,0 +1,188 @@
+// Copyright (c) 2018 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+
+#include "logging.h"
+#include "utils.h"
+#include "statestore.h"
+
+StateStore::StateStore(const std::string& path)
+        : mPath(path)
+{
+    if (mPath.empty())
+    {
+        return;
+    }
+
+    load();
+    mWriter = std::thread(&StateStore::writerLoop, this);
+}
+
+StateStore::~StateStore()
+{
+    if (mPath.empty())
+    {
+        return;
+    }
+
+    if (mSaveTimer)
+    {
+        g_source_remove(mSaveTimer);
+        save();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStopping = true;
+    }
+    mWakeup.notify_one();
+    mWriter.join();
+}
+
+pbnjson::JValue StateStore::getSaved(const std::string& section) const
+{
+    auto iter = mSections.find(section);
+    return (iter != mSections.end()) ? iter->second : pbnjson::JValue();
+}
+
+void StateStore::addSection(const std::string& section, Builder builder)
+{
+    mBuilders[section] = std::move(builder);
+}
+
+void StateStore::removeSection(const std::string& section)
+{
+    if (mSaveTimer)
+    {
+        g_source_remove(mSaveTimer);
+        save();
+    }
+    mBuilders.erase(section);
+}
+
+void StateStore::markDirty()
+{
+    if (mPath.empty() || mSaveTimer)
+    {
+        return;
+    }
+
+    // Bursts of changes end up in one write
+    mSaveTimer = g_timeout_add(SAVE_DELAY_MS, &StateStore::onSaveTimeout, this);
+}
+
+gboolean StateStore::onSaveTimeout(gpointer data)
+{
+    StateStore* store = static_cast<StateStore*>(data);
+
+    store->save();
+    return G_SOURCE_REMOVE;
+}
+
+void StateStore::load()
+{
+    gchar* contents = nullptr;
+    pbnjson::JValue snapshot;
+
+    if (!g_file_get_contents(mPath.c_str(), &contents, nullptr, nullptr))
+    {
+        LOG_DEBUG("No saved state in %s", mPath.c_str());
+        return;
+    }
+
+    bool parsed = LSUtils::parsePayload(contents, snapshot);
+    g_free(contents);
+
+    if (!parsed || !snapshot.isObject() || VERSION != snapshot["version"].asNumber<int>())
+    {
+        LOG_WARNING(MSGID_STATE_LOAD_ERROR, 0, "Ignoring invalid saved state in %s", mPath.c_str());
+        return;
+    }
+
+    for (pbnjson::JValue::KeyValue section : snapshot.children())
+    {
+        mSections[section.first.asString()] = section.second;
+    }
+}
+
+void StateStore::save()
+{
+    pbnjson::JValue snapshot = pbnjson::Object();
+    std::string payload;
+
+    mSaveTimer = 0;
+
+    for (auto& builder : mBuilders)
+    {
+        mSections[builder.first] = builder.second();
+    }
+
+    for (auto& section : mSections)
+    {
+        snapshot.put(section.first, section.second);
+    }
+    snapshot.put("version", VERSION);
+
+    if (!LSUtils::generatePayload(snapshot, payload))
+    {
+        LOG_ERROR(MSGID_STATE_SAVE_ERROR, 0, "Failed to serialize the state snapshot");
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        // An older snapshot not written yet is simply replaced
+        mPendingPayload = std::move(payload);
+    }
+    mWakeup.notify_one();
+}
+
+void StateStore::writerLoop()
+{
+    gchar* directory = g_path_get_dirname(mPath.c_str());
+    g_mkdir_with_parents(directory, 0755);
+    g_free(directory);
+
+    std::unique_lock<std::mutex> lock(mMutex);
+
+    while (true)
+    {
+        mWakeup.wait(lock, [this]() { return mStopping || !mPendingPayload.empty(); });
+
+        if (mPendingPayload.empty())
+        {
+            break;
+        }
+
+        std::string payload = std::move(mPendingPayload);
+        mPendingPayload.clear();
+        lock.unlock();
+
+        // Writes a temporary file and renames it over the old one
+        GError* error = nullptr;
+        if (!g_file_set_contents(mPath.c_str(), payload.c_str(), payload.size(), &error))
+        {
+            LOG_ERROR(MSGID_STATE_SAVE_ERROR, 0, "Failed to save state to %s: %s", mPath.c_str(),
+                      error ? error->message : "unknown error");
+            if (error)
+            {
+                g_error_free(error);
+            }
+        }
+
+        lock.lock();
+    }
+}
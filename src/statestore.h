@@ -0,0 +1,91 @@
+// Copyright (c) 2018 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+
+/**
+ * @file statestore.h
+ *
+ * @brief Snapshot of the audio state kept on disk across restarts
+ *
+ */
+#ifndef STATE_STORE_H
+#define STATE_STORE_H
+
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <glib.h>
+#include <pbnjson.hpp>
+
+/**
+ * JSON snapshot made of named sections, one per service. The snapshot
+ * found at startup is available through getSaved(); afterwards sections
+ * are rebuilt by their builder some time after markDirty() and written by
+ * a background thread, replacing the file atomically.
+ * All methods are main loop only.
+ */
+class StateStore
+{
+public:
+    using Builder = std::function<pbnjson::JValue()>;
+
+    /**
+     * @param path file holding the snapshot, empty to keep no state
+     */
+    explicit StateStore(const std::string& path);
+    ~StateStore();
+
+    StateStore(const StateStore &) = delete;
+    StateStore &operator=(const StateStore &) = delete;
+
+    // Section as saved by the previous run, null if there is none
+    pbnjson::JValue getSaved(const std::string& section) const;
+
+    void addSection(const std::string& section, Builder builder);
+
+    // Saves pending changes, after which builder is no longer called
+    void removeSection(const std::string& section);
+
+    // State changed, save a new snapshot soon
+    void markDirty();
+
+private:
+    static const guint SAVE_DELAY_MS = 500;
+    static const int VERSION = 1;
+
+    static gboolean onSaveTimeout(gpointer data);
+
+    void load();
+    void save();
+    void writerLoop();
+
+    std::string mPath;
+
+    std::map<std::string, pbnjson::JValue> mSections;
+    std::map<std::string, Builder> mBuilders;
+    guint mSaveTimer = 0;
+
+    std::mutex mMutex;
+    std::condition_variable mWakeup;
+    std::string mPendingPayload;
+    bool mStopping = false;
+    std::thread mWriter;
+};
+
+#endif
@@ -0,0 +1,195 @@
+// Copyright (c) 2018 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include <tuple>
+#include "stats.h"
+
+// Far longer than any HAL call, a request this old was never answered
+static const std::chrono::minutes maxPendingAge(5);
+
+LatencyStats::LatencyStats()
+{
+    reset();
+}
+
+void LatencyStats::record(std::chrono::steady_clock::duration elapsed, bool failed)
+{
+    uint64_t micros = std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+
+    // Bucket n holds [2^(n-1), 2^n) us, bucket 0 holds 0 us
+    int bucket = (0 == micros) ? 0 : 64 - __builtin_clzll(micros);
+    if (bucket >= BUCKETS)
+    {
+        bucket = BUCKETS - 1;
+    }
+
+    mBuckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    mCount.fetch_add(1, std::memory_order_relaxed);
+    mTotalMicros.fetch_add(micros, std::memory_order_relaxed);
+    if (failed)
+    {
+        mErrors.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    uint64_t max = mMaxMicros.load(std::memory_order_relaxed);
+    while (micros > max && !mMaxMicros.compare_exchange_weak(max, micros, std::memory_order_relaxed))
+    {
+    }
+}
+
+void LatencyStats::reset()
+{
+    for (auto& bucket : mBuckets)
+    {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+    mCount.store(0, std::memory_order_relaxed);
+    mErrors.store(0, std::memory_order_relaxed);
+    mTotalMicros.store(0, std::memory_order_relaxed);
+    mMaxMicros.store(0, std::memory_order_relaxed);
+}
+
+uint64_t LatencyStats::getPercentile(double fraction) const
+{
+    uint64_t count = mCount.load(std::memory_order_relaxed);
+    if (0 == count)
+    {
+        return 0;
+    }
+
+    uint64_t rank = static_cast<uint64_t>(fraction * count + 0.5);
+    uint64_t seen = 0;
+
+    for (int bucket = 0; bucket < BUCKETS; bucket++)
+    {
+        seen += mBuckets[bucket].load(std::memory_order_relaxed);
+        if (seen >= rank)
+        {
+            return (0 == bucket) ? 0 : (uint64_t(1) << bucket) - 1;
+        }
+    }
+
+    return mMaxMicros.load(std::memory_order_relaxed);
+}
+
+pbnjson::JValue LatencyStats::toJson(const std::string& name) const
+{
+    pbnjson::JValue statsObj = pbnjson::Object();
+    uint64_t count = mCount.load(std::memory_order_relaxed);
+
+    statsObj.put("name", name);
+    statsObj.put("count", static_cast<int64_t>(count));
+    statsObj.put("errors", static_cast<int64_t>(mErrors.load(std::memory_order_relaxed)));
+    statsObj.put("meanUs", count ? static_cast<int64_t>(mTotalMicros.load(std::memory_order_relaxed) / count) : 0);
+    statsObj.put("p50Us", static_cast<int64_t>(getPercentile(0.50)));
+    statsObj.put("p95Us", static_cast<int64_t>(getPercentile(0.95)));
+    statsObj.put("p99Us", static_cast<int64_t>(getPercentile(0.99)));
+    statsObj.put("maxUs", static_cast<int64_t>(mMaxMicros.load(std::memory_order_relaxed)));
+
+    return statsObj;
+}
+
+Stats& Stats::instance()
+{
+    static Stats stats;
+    return stats;
+}
+
+LatencyStats& Stats::get(Group group, const std::string& name)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    return mGroups[group].emplace(std::piecewise_construct,
+                                  std::forward_as_tuple(name),
+                                  std::forward_as_tuple()).first->second;
+}
+
+LatencyStats& Stats::get(LSMessage* message)
+{
+    return get(LUNA_METHOD, std::string(LSMessageGetCategory(message)) + "/" + LSMessageGetMethod(message));
+}
+
+void Stats::requestStarted(LSMessage* message, LatencyStats& stats)
+{
+    auto now = std::chrono::steady_clock::now();
+
+    // Drop answered requests from the front and fail the ones a handler
+    // never answered, the rest is younger
+    while (!mStarted.empty())
+    {
+        auto iter = mPending.find(mStarted.front().message);
+        if (iter != mPending.end() && iter->second.sequence == mStarted.front().sequence)
+        {
+            if (now - iter->second.start <= maxPendingAge)
+            {
+                break;
+            }
+
+            iter->second.stats->record(now - iter->second.start, true);
+            mPending.erase(iter);
+        }
+        mStarted.pop_front();
+    }
+
+    uint64_t sequence = ++mSequence;
+    mPending[message] = PendingRequest{LS::Message(message), &stats, now, sequence};
+    mStarted.push_back(StartedRequest{message, sequence});
+}
+
+void Stats::requestFinished(LSMessage* message, bool success)
+{
+    auto iter = mPending.find(message);
+    if (iter == mPending.end())
+    {
+        return;
+    }
+
+    iter->second.stats->record(std::chrono::steady_clock::now() - iter->second.start, !success);
+    mPending.erase(iter);
+}
+
+pbnjson::JValue Stats::toJson() const
+{
+    static const char* const groupNames[GROUP_COUNT] = { "methods", "hal" };
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    pbnjson::JValue statsObj = pbnjson::Object();
+
+    for (int group = 0; group < GROUP_COUNT; group++)
+    {
+        pbnjson::JArray array;
+        for (auto& iter : mGroups[group])
+        {
+            array.append(iter.second.toJson(iter.first));
+        }
+        statsObj.put(groupNames[group], array);
+    }
+
+    return statsObj;
+}
+
+void Stats::reset()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    for (auto& group : mGroups)
+    {
+        for (auto& iter : group)
+        {
+            iter.second.reset();
+        }
+    }
+}
@@ -0,0 +1,133 @@
+// Copyright (c) 2018 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+/**
+ * @file stats.h
+ *
+ * @brief Latency and error counters of Luna methods and HAL calls
+ *
+ */
+#ifndef STATS_H
+#define STATS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <pbnjson.hpp>
+#include <luna-service2/lunaservice.hpp>
+
+/**
+ * Call counters and a latency histogram with power of two microsecond
+ * buckets. Recording is lock-free and may happen on any thread.
+ */
+class LatencyStats
+{
+public:
+    LatencyStats();
+
+    LatencyStats(const LatencyStats &) = delete;
+    LatencyStats &operator=(const LatencyStats &) = delete;
+
+    void record(std::chrono::steady_clock::duration elapsed, bool failed);
+    void reset();
+
+    /**
+     * Upper bound in microseconds of the bucket holding the given
+     * fraction (0..1) of the recorded calls.
+     */
+    uint64_t getPercentile(double fraction) const;
+
+    pbnjson::JValue toJson(const std::string& name) const;
+
+private:
+    static const int BUCKETS = 32;
+
+    std::atomic<uint64_t> mBuckets[BUCKETS];
+    std::atomic<uint64_t> mCount;
+    std::atomic<uint64_t> mErrors;
+    std::atomic<uint64_t> mTotalMicros;
+    std::atomic<uint64_t> mMaxMicros;
+};
+
+/**
+ * Process wide registry of LatencyStats, exposed by /audio/getStats.
+ */
+class Stats
+{
+public:
+    enum Group
+    {
+        LUNA_METHOD,
+        HAL_CALL,
+        GROUP_COUNT
+    };
+
+    static Stats& instance();
+
+    /**
+     * Stats of the given name, created on first use.
+     * The reference stays valid for the lifetime of the process.
+     */
+    LatencyStats& get(Group group, const std::string& name);
+
+    /**
+     * Stats of the Luna method the message was sent to.
+     */
+    LatencyStats& get(LSMessage* message);
+
+    /**
+     * Luna request tracking, from dispatch to the response.
+     * Main loop only. A request holds a reference to its message until it
+     * is answered, so that a new message cannot reuse its address, and is
+     * counted as failed and dropped if it is left unanswered for too long.
+     */
+    void requestStarted(LSMessage* message, LatencyStats& stats);
+    void requestFinished(LSMessage* message, bool success);
+
+    pbnjson::JValue toJson() const;
+    void reset();
+
+private:
+    Stats() = default;
+
+    struct PendingRequest
+    {
+        LS::Message message;
+        LatencyStats* stats;
+        std::chrono::steady_clock::time_point start;
+        uint64_t sequence;
+    };
+
+    // Start order of the requests, oldest first, entries answered
+    // meanwhile are skipped when they reach the front
+    struct StartedRequest
+    {
+        LSMessage* message;
+        uint64_t sequence;
+    };
+
+    mutable std::mutex mMutex;
+    std::map<std::string, LatencyStats> mGroups[GROUP_COUNT];
+    std::unordered_map<LSMessage*, PendingRequest> mPending;
+    std::deque<StartedRequest> mStarted;
+    uint64_t mSequence = 0;
+};
+#endif
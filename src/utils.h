@@ -18,8 +18,15 @@
 #define _LS2_UTILS_H_
 
 #include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 #include <pbnjson.hpp>
 #include <luna-service2/lunaservice.hpp>
+#include "fielddecoder.h"
+#include "ratelimiter.h"
+#include "responsewriter.h"
+#include "stats.h"
 
 #define LS_CATEGORY_TABLE_NAME(name) name##_table
 
@@ -35,6 +42,11 @@
     &LS::Handle::methodWraper<cls, &cls::name>, \
     static_cast<LSMethodFlags>(0) },
 
+// Same as LS_CATEGORY_METHOD, also recording the latency of the method in Stats
+#define LS_CATEGORY_TIMED_METHOD(name) { #name, \
+    &LSUtils::timedMethod<cl_t, &cl_t::name>, \
+    static_cast<LSMethodFlags>(0) },
+
 #define LS_CREATE_CATEGORY_END \
 { nullptr, nullptr } \
     }; \
@@ -81,6 +93,7 @@
 #define API_ERROR_SCHEMA_VALIDATION       3
 #define API_ERROR_INVALID_PARAMETERS      4
 #define API_ERROR_NOT_IMPLEMENTED         10
+#define API_ERROR_TOO_MANY_REQUESTS       11
 #define API_ERROR_HAL_ERROR               20
 
 //Audio errors
@@ -96,6 +109,7 @@ const std::string errorUnknown("Unknown error");
 const std::string errorSchemavalidation("Failed to validate against schema");
 const std::string errorInvalidParameters("Invalid parameters");
 const std::string errorNotImplemented("Not implemented");
+const std::string errorTooManyRequests("Too many requests, retry later");
 const std::string errorHALError("Driver error while executing the command");
 const std::string errorAudioNotConnected("Audio not connected");
 const std::string errorInvalidSpeakertype("soundOutput not implemented");
@@ -127,64 +141,325 @@ inline bool parsePayload(const std::string &payload, pbnjson::JValue &object)
 }
 
 
-inline bool parsePayload(const std::string &payload, pbnjson::JValue &object, const std::string &schema, int *error)
+/**
+ * Why a request payload was rejected by parsePayload().
+ */
+struct ParseError
 {
-    pbnjson::JSchema parseSchema = pbnjson::JSchema::AllSchema();
+    int code = 0;           // API_ERROR_SCHEMA_VALIDATION once parsing failed
+    std::string property;   // offending property, empty if not known
+    std::string reason;     // what is wrong with the payload or the property
+};
+
+/**
+ * A request schema compiled once, plus its JSON definition which is only
+ * consulted to explain validation failures.
+ */
+class RequestSchema
+{
+public:
+    explicit RequestSchema(const std::string &schema)
+        : mSchema(pbnjson::JSchemaFragment(schema))
+    {
+        pbnjson::JDomParser parser;
+
+        if (parser.parse(schema, pbnjson::JSchema::AllSchema())) {
+            mDefinition = parser.getDom();
+        }
+    }
 
-    if (schema.length() > 0) {
-        parseSchema = pbnjson::JSchemaFragment(schema);
+    const pbnjson::JSchema &schema() const
+    {
+        return mSchema;
     }
 
-    pbnjson::JDomParser parser;
+    /**
+     * Find the property of an already parsed request which does not match
+     * the definition. Handles the plain object schemas built by the
+     * STRICT_SCHEMA/PROPS_x macros; returns false if nothing was found.
+     */
+    bool explain(const pbnjson::JValue &request, ParseError &error) const
+    {
+        if (!request.isObject()) {
+            error.reason = "payload is not an object";
+            return true;
+        }
 
-    if (!parser.parse(payload, parseSchema)) {
-        if (strstr(parser.getError(), "Schema error") != NULL) {
-            // notify this is a schema error, so that caller can make further
-            // checks for throwing custom errors (particular key missing, etc)
-            pbnjson::JSchema parseSchema = pbnjson::JSchema::AllSchema();
-
-            if (parser.parse(payload, parseSchema)) {
-                *error = API_ERROR_SCHEMA_VALIDATION;
-                object = parser.getDom();
+        pbnjson::JValue required = mDefinition["required"];
+        for (ssize_t i = 0; required.isArray() && i < required.arraySize(); i++) {
+            if (!request.hasKey(required[i].asString())) {
+                error.property = required[i].asString();
+                error.reason = "required property is missing";
+                return true;
             }
         }
 
+        pbnjson::JValue properties = mDefinition["properties"];
+        for (const pbnjson::JValue::KeyValue &child : request.children()) {
+            std::string name = child.first.asString();
+
+            if (!properties.hasKey(name)) {
+                error.property = name;
+                error.reason = "property is not allowed";
+                return true;
+            }
+
+            std::string type = properties[name]["type"].asString();
+            if (!matchesType(child.second, type)) {
+                error.property = name;
+                error.reason = "expected " + type;
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+private:
+    static bool matchesType(const pbnjson::JValue &value, const std::string &type)
+    {
+        if (type == "string") {
+            return value.isString();
+        } else if (type == "boolean") {
+            return value.isBoolean();
+        } else if (type == "integer") {
+            return value.isNumber() && value.asNumber<double>() == value.asNumber<int64_t>();
+        } else if (type == "number") {
+            return value.isNumber();
+        }
+
+        return true;
+    }
+
+    pbnjson::JSchema mSchema;
+    pbnjson::JValue mDefinition;
+};
+
+/**
+ * Request schemas of a Luna category, keyed by method name.
+ * Every schema is compiled once when the category is registered, so
+ * handlers validate against an already compiled JSchema on each call.
+ */
+class SchemaRegistry
+{
+public:
+    void add(const std::string &method, const std::string &schema)
+    {
+        mSchemas.emplace(method, RequestSchema(schema));
+    }
+
+    const RequestSchema &get(const std::string &method) const
+    {
+        static const RequestSchema anySchema(SCHEMA_ANY);
+
+        auto iter = mSchemas.find(method);
+        if (iter == mSchemas.end()) {
+            return anySchema;
+        }
+
+        return iter->second;
+    }
+
+private:
+    std::unordered_map<std::string, RequestSchema> mSchemas;
+};
+
+/**
+ * Parse the payload once and validate the resulting DOM against the schema.
+ * On a schema violation object still holds the parsed payload.
+ */
+inline bool parsePayload(const std::string &payload, pbnjson::JValue &object, const pbnjson::JSchema &parseSchema,
+                         int *error)
+{
+    pbnjson::JDomParser parser;
+
+    if (!parser.parse(payload, pbnjson::JSchema::AllSchema())) {
         return false;
     }
 
     object = parser.getDom();
+
+    if (!parseSchema.validate(object).isSuccess()) {
+        // notify this is a schema error, so that caller can make further
+        // checks for throwing custom errors (particular key missing, etc)
+        *error = API_ERROR_SCHEMA_VALIDATION;
+        return false;
+    }
+
     return true;
 }
 
+inline bool parsePayload(const std::string &payload, pbnjson::JValue &object, const std::string &schema, int *error)
+{
+    if (schema.length() > 0) {
+        return parsePayload(payload, object, pbnjson::JSchemaFragment(schema), error);
+    }
+
+    return parsePayload(payload, object, pbnjson::JSchema::AllSchema(), error);
+}
+
+/**
+ * Single pass variant of parsePayload() filling a structured error, which
+ * is reported to the caller by respondWithError(message, ParseError).
+ */
+inline bool parsePayload(const std::string &payload, pbnjson::JValue &object, const RequestSchema &schema,
+                         ParseError *error)
+{
+    pbnjson::JDomParser parser;
+
+    if (!parser.parse(payload, pbnjson::JSchema::AllSchema())) {
+        error->code = API_ERROR_SCHEMA_VALIDATION;
+        error->reason = parser.getError();
+        return false;
+    }
+
+    object = parser.getDom();
+
+    pbnjson::JResult result = schema.schema().validate(object);
+    if (!result.isSuccess()) {
+        error->code = API_ERROR_SCHEMA_VALIDATION;
+        if (!schema.explain(object, *error)) {
+            error->reason = result.errorString();
+        }
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * parsePayload() for the flat requests fields describes. Payloads fields
+ * decodes skip the DOM and the schema and leave object null. The others
+ * are validated against the schema, which explains why they are rejected
+ * or accepts them after all; fields are then filled from object.
+ */
+inline bool parsePayload(const char *payload, FieldDecoder &fields, pbnjson::JValue &object,
+                         const RequestSchema &schema, ParseError *error)
+{
+    if (fields.decode(payload)) {
+        return true;
+    }
+
+    if (!parsePayload(std::string(payload ? payload : ""), object, schema, error)) {
+        return false;
+    }
+
+    fields.decode(object);
+    return true;
+}
+
+/**
+ * Replies of the constant errors above, serialized once and sent as is.
+ * nullptr for any other text and code.
+ */
+inline const std::string *findErrorReply(const std::string &errorText, int errorCode)
+{
+    struct ErrorReply
+    {
+        int code;
+        std::string text;
+        std::string payload;
+    };
+
+    static const std::vector<ErrorReply> replies = []() {
+        const std::pair<int, const std::string *> errors[] = {
+            { API_ERROR_UNKNOWN, &errorUnknown },
+            { API_ERROR_INVALID_PARAMETERS, &errorInvalidParameters },
+            { API_ERROR_NOT_IMPLEMENTED, &errorNotImplemented },
+            { API_ERROR_TOO_MANY_REQUESTS, &errorTooManyRequests },
+            { API_ERROR_HAL_ERROR, &errorHALError },
+            { API_ERROR_AUDIO_NOT_CONNECTED, &errorAudioNotConnected },
+            { API_ERROR_INVALID_SPKTYPE, &errorInvalidSpeakertype },
+            { API_ERROR_VOLUME_LIMIT, &errorVolumeLimit },
+            { API_ERROR_VOLUME_LIMIT, &errorVolumeMaxMin },
+            { API_ERROR_CONNECTION_NOT_POSSIBLE, &errorConnectionNotPossible },
+            { API_ERROR_INVALID_VOLUME_CONTROL, &errorInvalidVolumeControl },
+        };
+
+        std::vector<ErrorReply> serialized;
+        ResponseWriter writer;
+
+        for (const auto &error : errors) {
+            serialized.push_back({ error.first, *error.second,
+                                   writer.begin(false).add("errorText", *error.second)
+                                         .add("errorCode", error.first).end() });
+        }
+
+        return serialized;
+    }();
+
+    for (const ErrorReply &reply : replies) {
+        if (reply.code == errorCode && reply.text == errorText) {
+            return &reply.payload;
+        }
+    }
+
+    return nullptr;
+}
+
 inline void respondWithError(LS::Message &message, const std::string &errorText, unsigned int errorCode = -1,
                              bool failedSubscription = false)
 {
-    pbnjson::JValue responseObj = pbnjson::Object();
+    const std::string *payload = failedSubscription ? nullptr : findErrorReply(errorText, errorCode);
 
-    if (failedSubscription) {
-        responseObj.put("subscribed", false);
+    if (!payload) {
+        ResponseWriter &writer = ResponseWriter::instance().begin(false);
+        if (failedSubscription) {
+            writer.add("subscribed", false);
+        }
+        payload = &writer.add("errorText", errorText).add("errorCode", (int) errorCode).end();
     }
 
-    responseObj.put("returnValue", false);
-    responseObj.put("errorText", errorText);
-    responseObj.put("errorCode", (int) errorCode);
+    Stats::instance().requestFinished(message.get(), false);
+    message.respond(payload->c_str());
+}
 
-    std::string payload;
-    generatePayload(responseObj, payload);
+/**
+ * Handler of LS_CATEGORY_TIMED_METHOD: records the latency of the method
+ * and rejects the request if the sender is over its RateLimiter budget.
+ */
+template<typename Class, bool (Class::*Method)(LSMessage&)>
+bool timedMethod(LSHandle *handle, LSMessage *message, void *context)
+{
+    // Resolved on the first call, handlers only run on the main loop
+    static LatencyStats *stats = nullptr;
+    static RateLimiter::Method *limit = nullptr;
 
-    message.respond(payload.c_str());
+    if (!stats) {
+        stats = &Stats::instance().get(message);
+        limit = RateLimiter::instance().find(message);
+    }
+
+    Stats::instance().requestStarted(message, *stats);
+
+    if (limit && !RateLimiter::instance().allow(*limit, message)) {
+        LS::Message request(message);
+        respondWithError(request, errorTooManyRequests, API_ERROR_TOO_MANY_REQUESTS);
+        return true;
+    }
+
+    return LS::Handle::methodWraper<Class, Method>(handle, message, context);
 }
 
 inline void respondWithErrorText(LS::Message &message, const std::string &errorText)
 {
-    pbnjson::JValue responseObj = pbnjson::Object();
+    const std::string &payload = ResponseWriter::instance().begin(false).add("errorText", errorText).end();
 
-    responseObj.put("returnValue", false);
-    responseObj.put("errorText", errorText);
+    Stats::instance().requestFinished(message.get(), false);
+    message.respond(payload.c_str());
+}
 
-    std::string payload;
-    generatePayload(responseObj, payload);
+inline void respondWithError(LS::Message &message, const ParseError &error)
+{
+    ResponseWriter &writer = ResponseWriter::instance().begin(false);
+
+    writer.add("errorText", errorSchemavalidation).add("errorCode", error.code).beginObject("errorDetails");
+    if (!error.property.empty()) {
+        writer.add("property", error.property);
+    }
+    const std::string &payload = writer.add("reason", error.reason).endObject().end();
 
+    Stats::instance().requestFinished(message.get(), false);
     message.respond(payload.c_str());
 }
 
@@ -207,6 +482,20 @@ inline void postToClient(LS::Message &message, pbnjson::JValue &object)
     std::string payload;
     LSUtils::generatePayload(object, payload);
 
+    Stats::instance().requestFinished(message.get(), object["returnValue"].asBool());
+
+    try {
+        message.respond(payload.c_str());
+    } catch (LS::Error &error) {
+        // to put debug log
+    }
+}
+
+// Respond with an already serialized successful reply
+inline void postToClient(LS::Message &message, const std::string &payload)
+{
+    Stats::instance().requestFinished(message.get(), true);
+
     try {
         message.respond(payload.c_str());
     } catch (LS::Error &error) {